@@ -0,0 +1,29 @@
+/*
+ * PUENTES DEL BENCHMARK DE ADMISION
+ * Interfaz comun de lo que mide src/bench-admision.cpp. Los monitores reales
+ * se adaptan en src/bench-admision-*.cpp, uno por fichero: cada adaptador
+ * incluye la cabecera del monitor que usa su simulador (monitor_puente.h,
+ * monitor_visual.h o monitor_compartido.h) y ninguna otra, porque las tres
+ * definen las mismas macros y algunos tipos con el mismo nombre.
+ */
+#ifndef BENCH_ADMISION_H
+#define BENCH_ADMISION_H
+
+#include <memory>
+
+#define MAX_HILOS 255
+
+// `hilo` va de 0 a MAX_HILOS - 1 y cada hilo usa siempre el mismo coche, que
+// vuelve a la cola en cuanto sale. `dir` es 0 (izquierda) o 1 (derecha).
+class PuenteBench {
+public:
+    virtual ~PuenteBench() {}
+    virtual void entrar(int hilo, int dir) = 0;
+    virtual void salir(int hilo, int dir) = 0;
+};
+
+std::unique_ptr<PuenteBench> crear_puente_duero();
+std::unique_ptr<PuenteBench> crear_puente_visualV2();
+std::unique_ptr<PuenteBench> crear_puente_V4();
+
+#endif
@@ -0,0 +1,225 @@
+/*
+ * CARGA DE TRAFICO
+ * Generacion reproducible de llegadas de coches.
+ *
+ * Cada generador usa su propio flujo aleatorio: un mt19937 derivado de una
+ * semilla comun y de un numero de flujo. No hay estado compartido entre hilos
+ * (ni cerrojos como el de rand()) y una misma semilla repite exactamente la
+ * secuencia de coches de cada generador.
+ *
+ * Procesos de llegada (intervalo entre coches de un sentido, en ms):
+ *   uniforme   minimo + U[0, rango), el comportamiento original
+ *   poisson    exponencial con la misma media que el uniforme
+ *   rafagas    MMPP de dos estados: calma y rafagas con la tasa multiplicada,
+ *              con la misma tasa media a largo plazo
+ *   diurna     Poisson no homogeneo con tasa senoidal (por aceptacion y
+ *              rechazo sobre la tasa maxima)
+ * El factor de cada sentido multiplica su tasa, para cargas asimetricas.
+ *
+ * Llegadas grabadas: fichero binario (cabecera de traza.h y registros de 16
+ * bytes ordenados por instante). Se proyecta con mmap y cada generador lo
+ * recorre con su propio CursorLlegadas, leyendo los registros en su sitio.
+ */
+#ifndef CARGA_H
+#define CARGA_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+
+#include "traza.h"
+
+enum TipoLlegadas { LLEGADAS_UNIFORME, LLEGADAS_POISSON, LLEGADAS_RAFAGAS, LLEGADAS_DIURNA };
+
+struct ConfiguracionCarga {
+    TipoLlegadas tipo = LLEGADAS_UNIFORME;
+    double factor[2] = {1.0, 1.0};          // multiplica la tasa de cada sentido
+    double rafaga_factor = 8.0;             // tasa en rafaga / tasa en calma
+    double rafaga_fraccion = 0.1;           // fraccion del tiempo en rafaga
+    double rafaga_duracion_ms = 10000;      // duracion media de una rafaga
+    double diurna_amplitud = 0.8;           // entre 0 y 1
+    double diurna_periodo_ms = 86400000;    // un dia
+};
+
+inline const char* nombre_llegadas(TipoLlegadas tipo) {
+    switch (tipo) {
+        case LLEGADAS_POISSON: return "poisson";
+        case LLEGADAS_RAFAGAS: return "rafagas";
+        case LLEGADAS_DIURNA: return "diurna";
+        default: return "uniforme";
+    }
+}
+
+inline bool leer_tipo_llegadas(const char* texto, TipoLlegadas& tipo) {
+    for (TipoLlegadas t : {LLEGADAS_UNIFORME, LLEGADAS_POISSON, LLEGADAS_RAFAGAS, LLEGADAS_DIURNA}) {
+        if (strcmp(texto, nombre_llegadas(t)) == 0) {
+            tipo = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+// splitmix64: semillas cercanas (1, 2, 3...) dan flujos sin correlacion.
+inline uint64_t mezclar_semilla(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+inline std::mt19937 flujo_aleatorio(uint64_t semilla, uint64_t flujo) {
+    uint64_t a = mezclar_semilla(semilla);
+    uint64_t b = mezclar_semilla(a ^ flujo);
+    std::seed_seq secuencia{(uint32_t)a, (uint32_t)(a >> 32), (uint32_t)b, (uint32_t)(b >> 32)};
+    return std::mt19937(secuencia);
+}
+
+// Proceso de llegadas de un sentido. Lleva su propio reloj (la suma de los
+// intervalos devueltos) para los procesos que dependen del instante.
+class ProcesoLlegadas {
+    ConfiguracionCarga cfg;
+    double minimo_ms;
+    double rango_ms;
+    double factor;
+    double media_ms;            // intervalo medio del proceso
+    double t_ms = 0;
+    bool en_rafaga = false;
+    double fin_estado_ms = -1;  // fin del estado actual del MMPP
+
+    static double exponencial(std::mt19937& gen, double media) {
+        return std::exponential_distribution<double>(1.0 / media)(gen);
+    }
+
+    double duracion_estado(std::mt19937& gen) const {
+        double rafaga = cfg.rafaga_duracion_ms;
+        double calma = rafaga * (1.0 - cfg.rafaga_fraccion) / cfg.rafaga_fraccion;
+        return exponencial(gen, en_rafaga ? rafaga : calma);
+    }
+
+    // Intervalo medio en cada estado para que la tasa media sea 1 / media_ms.
+    double media_estado() const {
+        double f = cfg.rafaga_fraccion;
+        double calma = media_ms * (1.0 - f + cfg.rafaga_factor * f);
+        return en_rafaga ? calma / cfg.rafaga_factor : calma;
+    }
+
+    double siguiente_rafagas(std::mt19937& gen) {
+        double inicio = t_ms;
+        if (fin_estado_ms < 0) {
+            en_rafaga = std::bernoulli_distribution(cfg.rafaga_fraccion)(gen);
+            fin_estado_ms = t_ms + duracion_estado(gen);
+        }
+        // Sin memoria: si la llegada cae despues del cambio de estado se
+        // descarta y se vuelve a sortear desde el cambio con la nueva tasa.
+        while (true) {
+            double llegada = t_ms + exponencial(gen, media_estado());
+            if (llegada <= fin_estado_ms) {
+                t_ms = llegada;
+                return t_ms - inicio;
+            }
+            t_ms = fin_estado_ms;
+            en_rafaga = !en_rafaga;
+            fin_estado_ms = t_ms + duracion_estado(gen);
+        }
+    }
+
+    double siguiente_diurna(std::mt19937& gen) {
+        double inicio = t_ms;
+        double maximo = 1.0 + cfg.diurna_amplitud;
+        std::uniform_real_distribution<double> u(0.0, 1.0);
+        while (true) {
+            t_ms += exponencial(gen, media_ms / maximo);
+            double tasa = 1.0 + cfg.diurna_amplitud * std::sin(2 * M_PI * t_ms / cfg.diurna_periodo_ms);
+            if (u(gen) * maximo <= tasa) {
+                return t_ms - inicio;
+            }
+        }
+    }
+
+public:
+    ProcesoLlegadas(const ConfiguracionCarga& c, int sentido, int llegada_min_ms, int llegada_rango_ms)
+        : cfg(c), minimo_ms(llegada_min_ms), rango_ms(llegada_rango_ms) {
+        factor = (cfg.factor[sentido] > 0) ? cfg.factor[sentido] : 1.0;
+        media_ms = (minimo_ms + rango_ms / 2.0) / factor;
+        cfg.rafaga_fraccion = std::min(0.99, std::max(0.01, cfg.rafaga_fraccion));
+        cfg.rafaga_factor = std::max(1.0, cfg.rafaga_factor);
+        cfg.diurna_amplitud = std::min(1.0, std::max(0.0, cfg.diurna_amplitud));
+    }
+
+    // Milisegundos hasta la siguiente llegada.
+    double siguiente_ms(std::mt19937& gen) {
+        if (media_ms <= 0) {
+            return 0;
+        }
+        switch (cfg.tipo) {
+            case LLEGADAS_POISSON: {
+                double intervalo = exponencial(gen, media_ms);
+                t_ms += intervalo;
+                return intervalo;
+            }
+            case LLEGADAS_RAFAGAS:
+                return siguiente_rafagas(gen);
+            case LLEGADAS_DIURNA:
+                return siguiente_diurna(gen);
+            default: {
+                double intervalo = minimo_ms;
+                if (rango_ms >= 1) {
+                    intervalo += std::uniform_int_distribution<int>(0, (int)rango_ms - 1)(gen);
+                }
+                intervalo /= factor;
+                t_ms += intervalo;
+                return intervalo;
+            }
+        }
+    }
+
+    double media() const { return media_ms; }
+};
+
+struct LlegadaGrabada {
+    int64_t tiempo_ms;          // instante de llegada (cualquier origen)
+    uint8_t direccion;          // 0 izquierda, 1 derecha
+    uint8_t peso_toneladas;
+    uint8_t altura_metros;
+    uint8_t falla;
+    uint8_t relleno[4];
+};
+
+static_assert(sizeof(LlegadaGrabada) == 16, "LlegadaGrabada forma parte del formato del fichero");
+
+const char MAGICO_LLEGADAS[8] = {'P', 'U', 'E', 'N', 'T', 'E', 'L', 'L'};
+const uint32_t VERSION_LLEGADAS = 1;
+
+typedef LectorTraza<LlegadaGrabada> FicheroLlegadas;
+
+// Recorre en orden las llegadas de un sentido. Los instantes se devuelven
+// relativos a la primera llegada del fichero (de cualquier sentido), para que
+// los dos cursores compartan el mismo origen.
+class CursorLlegadas {
+    const LlegadaGrabada* actual = nullptr;
+    const LlegadaGrabada* fin = nullptr;
+    int sentido = 0;
+    int64_t origen_ms = 0;
+
+public:
+    CursorLlegadas() {}
+
+    CursorLlegadas(const FicheroLlegadas& fichero, int s)
+        : actual(fichero.registros()), fin(fichero.registros() + fichero.cantidad()), sentido(s) {
+        if (actual < fin) origen_ms = actual->tiempo_ms;
+    }
+
+    const LlegadaGrabada* siguiente() {
+        while (actual < fin && actual->direccion != sentido) {
+            actual++;
+        }
+        return (actual < fin) ? actual++ : nullptr;
+    }
+
+    int64_t relativo_ms(const LlegadaGrabada& r) const { return r.tiempo_ms - origen_ms; }
+};
+
+#endif
@@ -0,0 +1,163 @@
+/*
+ * HISTOGRAMA DE LATENCIAS
+ * Histograma log-lineal al estilo HDR: los valores menores que 128 tienen
+ * cubeta propia y cada potencia de dos por encima se divide en 64 cubetas,
+ * asi que el error relativo de cualquier percentil es menor al 1.6% sin
+ * guardar las muestras. Registrar es O(1) y no reserva memoria.
+ *
+ * Histograma no es seguro entre hilos: cada hilo registra en el suyo y al
+ * final se combinan con combinar(). HistogramaConcurrente admite registros
+ * simultaneos desde cualquier hilo sin cerrojos (incrementos atomicos
+ * relajados) y se consulta a traves de una copia con instantanea().
+ */
+#ifndef HISTOGRAMA_H
+#define HISTOGRAMA_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+class HistogramaConcurrente;
+
+class Histograma {
+    friend class HistogramaConcurrente;
+
+public:
+    static const int BITS_SUB = 7;
+    static const uint64_t SUB = 1ULL << BITS_SUB;            // cubetas exactas
+    static const uint64_t MITAD = SUB / 2;                    // cubetas por potencia de 2
+    static const int NUM_CUBETAS = (int)(SUB + (64 - BITS_SUB) * MITAD);
+
+private:
+    uint64_t cuentas[NUM_CUBETAS];
+    uint64_t total;
+    uint64_t minimo_;
+    uint64_t maximo_;
+    double suma;
+
+public:
+    static int cubeta(uint64_t valor) {
+        if (valor < SUB) {
+            return (int)valor;
+        }
+        int msb = 63 - __builtin_clzll(valor);
+        int desplazamiento = msb - (BITS_SUB - 1);
+        return (int)(SUB + (desplazamiento - 1) * MITAD + ((valor >> desplazamiento) - MITAD));
+    }
+
+    // Mayor valor que cae en la cubeta (los percentiles se redondean hacia arriba).
+    static uint64_t valor_cubeta(int indice) {
+        if ((uint64_t)indice < SUB) {
+            return indice;
+        }
+        uint64_t k = indice - SUB;
+        int desplazamiento = (int)(k / MITAD) + 1;
+        uint64_t sub = k % MITAD + MITAD;
+        return ((sub + 1) << desplazamiento) - 1;
+    }
+
+    Histograma() { reiniciar(); }
+
+    void reiniciar() {
+        memset(cuentas, 0, sizeof(cuentas));
+        total = 0;
+        minimo_ = UINT64_MAX;
+        maximo_ = 0;
+        suma = 0;
+    }
+
+    void registrar(uint64_t valor) {
+        cuentas[cubeta(valor)]++;
+        total++;
+        suma += (double)valor;
+        if (valor < minimo_) minimo_ = valor;
+        if (valor > maximo_) maximo_ = valor;
+    }
+
+    void combinar(const Histograma& otro) {
+        for (int i = 0; i < NUM_CUBETAS; i++) {
+            cuentas[i] += otro.cuentas[i];
+        }
+        total += otro.total;
+        suma += otro.suma;
+        minimo_ = std::min(minimo_, otro.minimo_);
+        maximo_ = std::max(maximo_, otro.maximo_);
+    }
+
+    // p entre 0 y 100.
+    uint64_t percentil(double p) const {
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t objetivo = (uint64_t)(p / 100.0 * total + 0.5);
+        if (objetivo < 1) objetivo = 1;
+        if (objetivo > total) objetivo = total;
+
+        uint64_t acumulado = 0;
+        for (int i = 0; i < NUM_CUBETAS; i++) {
+            acumulado += cuentas[i];
+            if (acumulado >= objetivo) {
+                return std::min(valor_cubeta(i), maximo_);
+            }
+        }
+        return maximo_;
+    }
+
+    // Muestras hasta valor, redondeado hacia arriba al final de su cubeta.
+    uint64_t cuenta_hasta(uint64_t valor) const {
+        int ultima = cubeta(valor);
+        uint64_t acumulado = 0;
+        for (int i = 0; i <= ultima; i++) {
+            acumulado += cuentas[i];
+        }
+        return acumulado;
+    }
+
+    uint64_t cuenta() const { return total; }
+    uint64_t minimo() const { return total ? minimo_ : 0; }
+    uint64_t maximo() const { return maximo_; }
+    double media() const { return total ? suma / total : 0.0; }
+};
+
+class HistogramaConcurrente {
+    std::atomic<uint64_t> cuentas[Histograma::NUM_CUBETAS];
+    std::atomic<uint64_t> minimo_{UINT64_MAX};
+    std::atomic<uint64_t> maximo_{0};
+    std::atomic<uint64_t> suma{0};
+
+public:
+    HistogramaConcurrente() {
+        for (auto& c : cuentas) {
+            c.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void registrar(uint64_t valor) {
+        cuentas[Histograma::cubeta(valor)].fetch_add(1, std::memory_order_relaxed);
+        suma.fetch_add(valor, std::memory_order_relaxed);
+
+        uint64_t actual = minimo_.load(std::memory_order_relaxed);
+        while (valor < actual && !minimo_.compare_exchange_weak(actual, valor, std::memory_order_relaxed)) {
+        }
+        actual = maximo_.load(std::memory_order_relaxed);
+        while (valor > actual && !maximo_.compare_exchange_weak(actual, valor, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Copia no atomica en conjunto: con registros en curso puede mezclar
+    // valores de instantes ligeramente distintos.
+    Histograma instantanea() const {
+        Histograma h;
+        for (int i = 0; i < Histograma::NUM_CUBETAS; i++) {
+            h.cuentas[i] = cuentas[i].load(std::memory_order_relaxed);
+            h.total += h.cuentas[i];
+        }
+        h.minimo_ = minimo_.load(std::memory_order_relaxed);
+        h.maximo_ = maximo_.load(std::memory_order_relaxed);
+        h.suma = (double)suma.load(std::memory_order_relaxed);
+        return h;
+    }
+};
+
+#endif
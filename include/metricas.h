@@ -0,0 +1,290 @@
+/*
+ * METRICAS
+ * Contadores para exponer en formato de texto de Prometheus sin tocar los
+ * cerrojos del programa.
+ *
+ * ContadoresFragmentados: cada hilo suma en su propio fragmento (una linea de
+ * cache por grupo de contadores) con incrementos atomicos relajados, y la
+ * lectura suma todos los fragmentos. Los hilos se reparten los fragmentos por
+ * orden de llegada; si hay mas hilos que fragmentos algunos los comparten, lo
+ * que sigue siendo correcto pero con algo de contencion.
+ *
+ * TextoPrometheus: arma la respuesta (HELP, TYPE, muestras con etiquetas e
+ * histogramas acumulados a partir de un Histograma).
+ *
+ * ServidorMetricas: un hilo que atiende GET /metrics por HTTP/1.0 en un
+ * puerto TCP local o en un socket Unix y devuelve lo que genere la funcion
+ * que se le pasa. Cada peticion se atiende y se cierra; no hay keep-alive.
+ */
+#ifndef METRICAS_H
+#define METRICAS_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "histograma.h"
+
+inline unsigned indice_fragmento_hilo() {
+    static std::atomic<unsigned> siguiente{0};
+    thread_local unsigned indice = siguiente.fetch_add(1, std::memory_order_relaxed);
+    return indice;
+}
+
+template <int NUM_CONTADORES, int NUM_FRAGMENTOS = 16>
+class ContadoresFragmentados {
+    struct alignas(64) Fragmento {
+        std::atomic<uint64_t> valores[NUM_CONTADORES];
+    };
+    Fragmento fragmentos[NUM_FRAGMENTOS];
+
+public:
+    ContadoresFragmentados() {
+        for (Fragmento& f : fragmentos) {
+            for (auto& v : f.valores) v.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void sumar(int contador, uint64_t n = 1) {
+        Fragmento& f = fragmentos[indice_fragmento_hilo() % NUM_FRAGMENTOS];
+        f.valores[contador].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t total(int contador) const {
+        uint64_t suma = 0;
+        for (const Fragmento& f : fragmentos) {
+            suma += f.valores[contador].load(std::memory_order_relaxed);
+        }
+        return suma;
+    }
+};
+
+class TextoPrometheus {
+    std::string texto;
+
+    void numero(double valor) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.15g", valor);
+        texto += buffer;
+    }
+
+public:
+    void cabecera(const char* nombre, const char* tipo, const char* ayuda) {
+        texto += "# HELP ";
+        texto += nombre;
+        texto += ' ';
+        texto += ayuda;
+        texto += "\n# TYPE ";
+        texto += nombre;
+        texto += ' ';
+        texto += tipo;
+        texto += '\n';
+    }
+
+    // etiquetas ya formateadas, por ejemplo "sentido=\"izquierda\"", o vacio.
+    void muestra(const std::string& nombre, const std::string& etiquetas, double valor) {
+        texto += nombre;
+        if (!etiquetas.empty()) {
+            texto += '{';
+            texto += etiquetas;
+            texto += '}';
+        }
+        texto += ' ';
+        numero(valor);
+        texto += '\n';
+    }
+
+    // Histograma acumulado. escala convierte las unidades del Histograma a
+    // las de los limites (por ejemplo 1e-6 de microsegundos a segundos). Cada
+    // cubeta cuenta las muestras hasta el limite redondeado a la cubeta del
+    // Histograma que lo contiene (error relativo menor al 1.6%).
+    void histograma(const std::string& nombre, const std::string& etiquetas, const Histograma& h,
+                    const double* limites, int num_limites, double escala) {
+        std::string prefijo = etiquetas.empty() ? "" : etiquetas + ",";
+        for (int i = 0; i < num_limites; i++) {
+            char le[32];
+            snprintf(le, sizeof(le), "%g", limites[i]);
+            muestra(nombre + "_bucket", prefijo + "le=\"" + le + "\"",
+                    (double)h.cuenta_hasta((uint64_t)(limites[i] / escala)));
+        }
+        muestra(nombre + "_bucket", prefijo + "le=\"+Inf\"", (double)h.cuenta());
+        muestra(nombre + "_sum", etiquetas, h.media() * h.cuenta() * escala);
+        muestra(nombre + "_count", etiquetas, (double)h.cuenta());
+    }
+
+    const std::string& str() const { return texto; }
+};
+
+class ServidorMetricas {
+    int fd_escucha = -1;
+    std::string ruta_unix;
+    dev_t socket_dev = 0;        // el socket que creo iniciar, para no borrar otro
+    ino_t socket_ino = 0;
+    std::atomic<bool> activo{false};
+    std::thread hilo;
+    std::function<std::string()> generar;
+
+    static bool enviar_todo(int fd, const char* datos, size_t tamano) {
+        while (tamano > 0) {
+            ssize_t n = ::send(fd, datos, tamano, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            datos += n;
+            tamano -= n;
+        }
+        return true;
+    }
+
+    void atender(int fd) {
+        // Basta con la linea de peticion; el resto de cabeceras se ignora.
+        char peticion[2048];
+        size_t leidos = 0;
+        while (leidos < sizeof(peticion) - 1) {
+            ssize_t n = ::recv(fd, peticion + leidos, sizeof(peticion) - 1 - leidos, 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            leidos += n;
+            peticion[leidos] = '\0';
+            if (strstr(peticion, "\r\n\r\n") || strstr(peticion, "\n\n")) break;
+        }
+        peticion[leidos] = '\0';
+
+        std::string cuerpo;
+        const char* estado;
+        if (strncmp(peticion, "GET /metrics", 12) == 0 || strncmp(peticion, "GET / ", 6) == 0) {
+            estado = "200 OK";
+            cuerpo = generar();
+        } else {
+            estado = "404 Not Found";
+            cuerpo = "use GET /metrics\n";
+        }
+        char cabecera[256];
+        int n = snprintf(cabecera, sizeof(cabecera),
+                         "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                         "Content-Length: %zu\r\nConnection: close\r\n\r\n",
+                         estado, cuerpo.size());
+        if (enviar_todo(fd, cabecera, n)) {
+            enviar_todo(fd, cuerpo.data(), cuerpo.size());
+        }
+    }
+
+    void bucle() {
+        while (activo.load()) {
+            struct pollfd p = {fd_escucha, POLLIN, 0};
+            if (::poll(&p, 1, 200) <= 0) continue;
+            int fd = ::accept(fd_escucha, nullptr, nullptr);
+            if (fd == -1) continue;
+            struct timeval limite = {1, 0};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &limite, sizeof(limite));
+            atender(fd);
+            ::close(fd);
+        }
+    }
+
+public:
+    ServidorMetricas() {}
+    ServidorMetricas(const ServidorMetricas&) = delete;
+    ServidorMetricas& operator=(const ServidorMetricas&) = delete;
+
+    ~ServidorMetricas() { detener(); }
+
+    // direccion: "PUERTO" (127.0.0.1), "HOST:PUERTO" o una ruta con '/' para
+    // un socket Unix.
+    bool iniciar(const std::string& direccion, std::function<std::string()> g, std::string& error) {
+        generar = std::move(g);
+        if (direccion.find('/') != std::string::npos) {
+            struct sockaddr_un dir = {};
+            dir.sun_family = AF_UNIX;
+            if (direccion.size() >= sizeof(dir.sun_path)) {
+                error = "ruta de socket demasiado larga";
+                return false;
+            }
+            strcpy(dir.sun_path, direccion.c_str());
+            // Solo se borra un socket que quedara de otra ejecucion: cualquier
+            // otro fichero (p. ej. --metricas ./informe.csv) es un error.
+            struct stat previo;
+            if (::lstat(dir.sun_path, &previo) == 0) {
+                if (!S_ISSOCK(previo.st_mode)) {
+                    error = direccion + " existe y no es un socket";
+                    return false;
+                }
+                ::unlink(dir.sun_path);
+            }
+            fd_escucha = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd_escucha == -1 || ::bind(fd_escucha, (struct sockaddr*)&dir, sizeof(dir)) == -1) {
+                error = std::string("socket Unix: ") + strerror(errno);
+                return false;
+            }
+            struct stat creado;
+            if (::lstat(dir.sun_path, &creado) == 0) {
+                socket_dev = creado.st_dev;
+                socket_ino = creado.st_ino;
+            }
+            ruta_unix = direccion;
+        } else {
+            std::string host = "127.0.0.1";
+            std::string puerto = direccion;
+            size_t dos_puntos = direccion.rfind(':');
+            if (dos_puntos != std::string::npos) {
+                host = direccion.substr(0, dos_puntos);
+                puerto = direccion.substr(dos_puntos + 1);
+            }
+            struct sockaddr_in dir = {};
+            dir.sin_family = AF_INET;
+            dir.sin_port = htons((uint16_t)atoi(puerto.c_str()));
+            if (inet_pton(AF_INET, host.c_str(), &dir.sin_addr) != 1) {
+                error = "direccion IPv4 no valida: " + host;
+                return false;
+            }
+            fd_escucha = ::socket(AF_INET, SOCK_STREAM, 0);
+            int si = 1;
+            if (fd_escucha != -1) setsockopt(fd_escucha, SOL_SOCKET, SO_REUSEADDR, &si, sizeof(si));
+            if (fd_escucha == -1 || ::bind(fd_escucha, (struct sockaddr*)&dir, sizeof(dir)) == -1) {
+                error = std::string("TCP: ") + strerror(errno);
+                return false;
+            }
+        }
+        if (::listen(fd_escucha, 16) == -1) {
+            error = std::string("listen: ") + strerror(errno);
+            return false;
+        }
+        activo = true;
+        hilo = std::thread(&ServidorMetricas::bucle, this);
+        return true;
+    }
+
+    void detener() {
+        if (activo.exchange(false)) {
+            hilo.join();
+        }
+        if (fd_escucha != -1) {
+            ::close(fd_escucha);
+            fd_escucha = -1;
+        }
+        if (!ruta_unix.empty()) {
+            // Si la ruta ya no es el socket creado por iniciar (lo borraron o
+            // lo sustituyeron) se deja como esta.
+            struct stat actual;
+            if (::lstat(ruta_unix.c_str(), &actual) == 0 && S_ISSOCK(actual.st_mode) &&
+                actual.st_dev == socket_dev && actual.st_ino == socket_ino) {
+                ::unlink(ruta_unix.c_str());
+            }
+            ruta_unix.clear();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ * MONITOR COMPARTIDO DEL PUENTE (sim_puenteV4)
+ * Monitor del puente pensado para memoria compartida entre procesos, con las
+ * mismas reglas que MonitorPuente (sentido unico, turno, capacidad y coches
+ * seguidos). El cerrojo y las colas de cada sentido son palabras futex: si no
+ * hay contencion entrar y salir no hacen ninguna llamada al sistema.
+ *
+ * Cada llamada a futex se suma al contador que recibe, para que quien use las
+ * primitivas con otras palabras (la cola de trabajos de V4) las cuente aparte.
+ * entrar_puente y salir_puente no escriben nada: devuelven lo que el programa
+ * necesita para su log.
+ */
+#ifndef MONITOR_COMPARTIDO_H
+#define MONITOR_COMPARTIDO_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define MAX_COCHES_SIMULTANEOS 3
+#define MAX_COCHES_SEGUIDOS 5
+
+enum Direccion { IZQUIERDA = 0, DERECHA = 1, NINGUNO = 2 };
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "el monitor compartido necesita atomicos sin cerrojo");
+
+struct MonitorCompartido {
+    std::atomic<uint32_t> cerrojo;  // 0 libre, 1 tomado, 2 tomado con procesos esperando
+    std::atomic<uint32_t> cola[2];  // cambia cada vez que puede haber paso para el sentido
+    int durmiendo[2];               // procesos dormidos en cada cola
+
+    int en_puente[2];
+    int seguidos[2];
+    int esperando[2];
+    Direccion turno;
+
+    std::atomic<uint64_t> llamadas_futex;
+    int max_en_puente;
+    int cambios_turno;
+};
+
+inline long futex(std::atomic<uint32_t>* palabra, int op, uint32_t valor, std::atomic<uint64_t>& llamadas) {
+    llamadas.fetch_add(1, std::memory_order_relaxed);
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(palabra), op, valor, NULL, NULL, 0);
+}
+
+// Cerrojo de tres estados (Drepper, "Futexes Are Tricky").
+inline void bloquear(std::atomic<uint32_t>& cerrojo, std::atomic<uint64_t>& llamadas) {
+    uint32_t c = 0;
+    if (cerrojo.compare_exchange_strong(c, 1)) {
+        return;
+    }
+    if (c != 2) {
+        c = cerrojo.exchange(2);
+    }
+    while (c != 0) {
+        futex(&cerrojo, FUTEX_WAIT, 2, llamadas);
+        c = cerrojo.exchange(2);
+    }
+}
+
+inline void desbloquear(std::atomic<uint32_t>& cerrojo, std::atomic<uint64_t>& llamadas) {
+    if (cerrojo.exchange(0) == 2) {
+        futex(&cerrojo, FUTEX_WAKE, 1, llamadas);
+    }
+}
+
+// Se llama con `cerrojo` tomado y vuelve con el tomado. La palabra se lee con
+// el cerrojo tomado: si alguien la cambia antes de que este proceso duerma,
+// FUTEX_WAIT vuelve en seguida.
+inline void esperar_cambio(std::atomic<uint32_t>& cerrojo, std::atomic<uint32_t>& palabra, int& durmiendo,
+                           std::atomic<uint64_t>& llamadas) {
+    uint32_t visto = palabra.load();
+    durmiendo++;
+    desbloquear(cerrojo, llamadas);
+    futex(&palabra, FUTEX_WAIT, visto, llamadas);
+    bloquear(cerrojo, llamadas);
+    durmiendo--;
+}
+
+// Se llama con el cerrojo tomado; FUTEX_WAKE se hace despues de soltarlo y
+// solo si avisar_cambio devolvio true (habia alguien dormido).
+inline bool avisar_cambio(std::atomic<uint32_t>& palabra, int durmiendo) {
+    if (durmiendo == 0) {
+        return false;
+    }
+    palabra.fetch_add(1);
+    return true;
+}
+
+// Deja el monitor listo en memoria ya puesta a cero.
+inline void inicializar_monitor_compartido(MonitorCompartido* m) {
+    m->turno = NINGUNO;
+}
+
+// Se llama con el cerrojo tomado.
+inline bool puede_pasar(const MonitorCompartido* m, Direccion mi_dir) {
+    Direccion otra_dir = (mi_dir == IZQUIERDA) ? DERECHA : IZQUIERDA;
+    bool es_mi_turno = (m->turno == mi_dir || m->turno == NINGUNO);
+    bool puente_libre = (m->en_puente[otra_dir] == 0);
+    bool hay_capacidad = (m->en_puente[mi_dir] < MAX_COCHES_SIMULTANEOS);
+    bool puede_pasar_seguido = true;
+    if (m->esperando[otra_dir] > 0) {
+        puede_pasar_seguido = (m->seguidos[mi_dir] < MAX_COCHES_SEGUIDOS);
+    }
+    return es_mi_turno && puente_libre && hay_capacidad && puede_pasar_seguido;
+}
+
+// Se llama con el cerrojo tomado. Coches de `dir` que podrian entrar ahora
+// mismo segun las mismas reglas de puede_pasar.
+inline int plazas_libres(const MonitorCompartido* m, Direccion dir) {
+    Direccion otra_dir = (dir == IZQUIERDA) ? DERECHA : IZQUIERDA;
+    if ((m->turno != dir && m->turno != NINGUNO) || m->en_puente[otra_dir] > 0) {
+        return 0;
+    }
+    int plazas = MAX_COCHES_SIMULTANEOS - m->en_puente[dir];
+    if (m->esperando[otra_dir] > 0) {
+        plazas = std::min(plazas, MAX_COCHES_SEGUIDOS - m->seguidos[dir]);
+    }
+    return std::max(plazas, 0);
+}
+
+// Ocupacion del sentido justo despues de una admision.
+struct PasoCompartido {
+    int en_puente;
+    int seguidos;
+};
+
+// Bloquea hasta que el coche puede entrar en el puente y lo admite.
+inline PasoCompartido entrar_puente(MonitorCompartido* m, Direccion mi_dir) {
+    Direccion otra_dir = (mi_dir == IZQUIERDA) ? DERECHA : IZQUIERDA;
+
+    bloquear(m->cerrojo, m->llamadas_futex);
+    m->esperando[mi_dir]++;
+    while (!puede_pasar(m, mi_dir)) {
+        esperar_cambio(m->cerrojo, m->cola[mi_dir], m->durmiendo[mi_dir], m->llamadas_futex);
+    }
+
+    m->esperando[mi_dir]--;
+    if (m->turno == NINGUNO) {
+        m->turno = mi_dir;
+    }
+    m->en_puente[mi_dir]++;
+    if (m->esperando[otra_dir] > 0) {
+        m->seguidos[mi_dir]++;
+    }
+    m->max_en_puente = std::max(m->max_en_puente, m->en_puente[mi_dir]);
+    PasoCompartido paso = {m->en_puente[mi_dir], m->seguidos[mi_dir]};
+    desbloquear(m->cerrojo, m->llamadas_futex);
+    return paso;
+}
+
+// Saca un coche del puente. Devuelve true si el turno paso al otro sentido.
+inline bool salir_puente(MonitorCompartido* m, Direccion mi_dir) {
+    Direccion otra_dir = (mi_dir == IZQUIERDA) ? DERECHA : IZQUIERDA;
+    bool cambio_turno = false;
+
+    bloquear(m->cerrojo, m->llamadas_futex);
+    m->en_puente[mi_dir]--;
+    if (m->en_puente[mi_dir] == 0) {
+        if (m->seguidos[mi_dir] >= MAX_COCHES_SEGUIDOS) {
+            m->seguidos[mi_dir] = 0;
+        }
+        if (m->esperando[otra_dir] > 0) {
+            m->turno = otra_dir;
+            m->cambios_turno++;
+            cambio_turno = true;
+        } else {
+            m->turno = NINGUNO;
+            m->seguidos[mi_dir] = 0;
+        }
+    }
+    // Solo puede avanzar un sentido: el otro si acaba de recibir el turno y si
+    // no el propio. Se despiertan tantos dormidos como plazas tenga; un
+    // despertado que pierde la plaza con uno recien llegado vuelve a dormir y
+    // lo despertara la salida de ese coche.
+    Direccion avanza = cambio_turno ? otra_dir : mi_dir;
+    int despertar = std::min(plazas_libres(m, avanza), m->durmiendo[avanza]);
+    if (despertar > 0) {
+        avisar_cambio(m->cola[avanza], m->durmiendo[avanza]);
+    }
+    desbloquear(m->cerrojo, m->llamadas_futex);
+
+    if (despertar > 0) {
+        futex(&m->cola[avanza], FUTEX_WAKE, despertar, m->llamadas_futex);
+    }
+    return cambio_turno;
+}
+
+#endif
@@ -0,0 +1,1087 @@
+/*
+ * MONITOR DEL PUENTE (sim-puente-duero)
+ * MonitorConPolitica y todo lo que necesita: el coche, el estado empaquetado
+ * del puente, las politicas de turno, el registro de eventos y la traza
+ * binaria. MonitorPuente es el monitor con la regla original. El programa
+ * declara su propio monitor global y el benchmark de admision crea los suyos,
+ * asi que aqui no hay ninguno.
+ *
+ * Los valores por omision de las reglas son estos #define; LimitesPuente
+ * permite crear monitores con otros.
+ */
+#ifndef MONITOR_PUENTE_H
+#define MONITOR_PUENTE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "registro_asincrono.h"
+#include "reloj.h"
+#include "histograma.h"
+#include "traza.h"
+#include "metricas.h"
+
+#define MAX_COCHES_SIMULTANEOS 3
+#define MAX_COCHES_SEGUIDOS 5
+
+#define MAX_PESO_TON 20
+#define MAX_ALTURA_M 4
+
+// Reglas del puente que aplica cada monitor. Los #define dan los valores por
+// omision; el barrido de parametros crea monitores con otros valores.
+struct LimitesPuente {
+    int max_simultaneos = MAX_COCHES_SIMULTANEOS;
+    int max_seguidos = MAX_COCHES_SEGUIDOS;
+    int max_peso_ton = MAX_PESO_TON;
+    int max_altura_m = MAX_ALTURA_M;
+};
+
+enum Direccion { IZQUIERDA = 0, DERECHA = 1, NINGUNO = 2 };
+enum EstadoCoche { ESPERANDO, CRUZANDO, FINALIZADO, RECHAZADO }; 
+
+// Hueco de espera propio de cada coche que duerme en el monitor. El monitor
+// solo lo despierta cuando ya le ha concedido el paso (o lo ha rechazado).
+struct EsperaCoche {
+    std::condition_variable cv;
+    bool resuelto = false;
+};
+
+struct Coche {
+    int id;
+    Direccion direccion;
+    EstadoCoche estado;
+    std::chrono::time_point<std::chrono::steady_clock> tiempo_llegada;
+    std::chrono::time_point<std::chrono::steady_clock> tiempo_inicio_cruce;
+    std::chrono::time_point<std::chrono::steady_clock> tiempo_salida;
+
+    int peso_toneladas;         
+    int altura_metros;          
+    bool falla_mecanica_grave;  
+    int retardo_cola_ms = 0;    // entre la llegada a la cola y la solicitud
+    uint64_t orden_aparcado = 0;    // orden global al aparcar en el monitor
+
+    void* continuacion = nullptr;
+    EsperaCoche* espera = nullptr;
+};
+
+inline std::string direccion_str(Direccion dir) {
+    switch(dir) {
+        case IZQUIERDA: return "IZQUIERDA";
+        case DERECHA: return "DERECHA";
+        default: return "NINGUNO";
+    }
+}
+
+inline bool registro_habilitado = true;
+
+// Al despachar una cola, admite de una vez todos los coches que las reglas
+// permiten (un solo CAS por lote) en lugar de evaluarlos uno a uno.
+inline bool admision_por_convoy = true;
+
+
+// Eventos que el monitor registra en el camino caliente. Se guardan como
+// registros de tamaño fijo y el texto se arma en el hilo de escritura, fuera
+// del mutex del monitor.
+enum TipoRegistro : uint8_t {
+    REG_TEXTO,
+    REG_SENSOR_ENTRADA,
+    REG_EN_COLA,
+    REG_PERMISO,
+    REG_DETENIDO,
+    REG_SUSPENSION,
+    REG_SALIDA,
+    REG_CAMBIO_TURNO
+};
+
+enum MotivoRechazo : uint8_t { SIN_RECHAZO, RECHAZO_PESO, RECHAZO_ALTURA, RECHAZO_FALLA };
+
+#define TEXTO_REGISTRO 88
+
+struct RegistroMonitor {
+    int64_t instante_ms;
+    int32_t coche;
+    int32_t valor[3];
+    uint8_t tipo;
+    uint8_t direccion;
+    uint8_t motivo;
+    char texto[TEXTO_REGISTRO];     // solo REG_TEXTO, recortado
+};
+
+// Si es nulo los eventos se formatean y escriben en el propio hilo. Se cambia
+// con fijar_registro_eventos; publicar_registro se anuncia en
+// publicando_registro antes de leer el puntero, asi quien lo quita sabe cuando
+// nadie usa ya el anterior.
+inline std::atomic<RegistroAsincrono<RegistroMonitor>*> registro_eventos{nullptr};
+inline std::atomic<int> publicando_registro{0};
+
+// Al volver, nadie sigue publicando en el registro anterior y puede
+// destruirse aunque queden hilos sueltos (el de intervencion hace detach).
+inline void fijar_registro_eventos(RegistroAsincrono<RegistroMonitor>* registro) {
+    registro_eventos.store(registro);
+    while (publicando_registro.load() > 0) {
+        std::this_thread::yield();
+    }
+}
+
+inline void registrar_evento(TipoRegistro tipo, const Coche* coche, int valor0, int valor1, MotivoRechazo motivo, int valor2);
+
+// Traza binaria de las transiciones del monitor (--traza). Llegada, solicitud,
+// salida, bloqueo y reanudacion son las entradas que --reproducir vuelve a
+// aplicar; admision, rechazo y cambio de turno son las decisiones del monitor
+// con las que se compara la reproduccion.
+enum TipoTraza : uint8_t {
+    TRAZA_LLEGADA,
+    TRAZA_SOLICITUD,
+    TRAZA_ADMISION,
+    TRAZA_SALIDA,
+    TRAZA_RECHAZO,
+    TRAZA_CAMBIO_TURNO,
+    TRAZA_BLOQUEO,
+    TRAZA_REANUDACION
+};
+
+struct EventoTraza {
+    int64_t tiempo_us;
+    int32_t coche;              // -1 en bloqueo y reanudacion
+    uint8_t tipo;
+    uint8_t direccion;
+    uint8_t peso_toneladas;
+    uint8_t altura_metros;
+    uint8_t falla;
+    uint8_t relleno[7];
+};
+
+static_assert(sizeof(EventoTraza) == 24, "EventoTraza forma parte del formato del fichero");
+
+const char MAGICO_TRAZA[8] = {'P', 'U', 'E', 'N', 'T', 'E', 'T', 'R'};
+#define VERSION_TRAZA 1
+
+typedef EscritorTraza<EventoTraza> TrazaPuente;
+
+// Estado caliente del puente empaquetado en una sola palabra de 64 bits para
+// poder admitir y sacar coches con CAS sin tomar el mutex del monitor.
+//   bits  0-7   coches_en_puente[IZQ], coches_en_puente[DER] (4 bits c/u)
+//   bits  8-15  coches_seguidos[IZQ], coches_seguidos[DER]   (4 bits c/u)
+//   bits 16-17  turno
+//   bit  18     puente bloqueado
+//   bits 19-62  coches_esperando[IZQ], coches_esperando[DER] (22 bits c/u)
+struct EstadoPuente {
+    static constexpr int BITS_PUENTE = 4;
+    static constexpr int BITS_ESPERANDO = 22;
+    static constexpr int DESP_PUENTE = 0;
+    static constexpr int DESP_SEGUIDOS = 2 * BITS_PUENTE;
+    static constexpr int DESP_TURNO = 4 * BITS_PUENTE;
+    static constexpr int DESP_BLOQUEADO = DESP_TURNO + 2;
+    static constexpr int DESP_ESPERANDO = DESP_BLOQUEADO + 1;
+    static constexpr uint64_t MASCARA_PUENTE = (1ULL << BITS_PUENTE) - 1;
+    static constexpr uint64_t MASCARA_ESPERANDO = (1ULL << BITS_ESPERANDO) - 1;
+    static constexpr uint64_t BIT_BLOQUEADO = 1ULL << DESP_BLOQUEADO;
+
+    int en_puente[2];
+    int seguidos[2];
+    int esperando[2];
+    Direccion turno;
+    bool bloqueado;
+
+    static uint64_t un_esperando(Direccion dir) {
+        return 1ULL << (DESP_ESPERANDO + dir * BITS_ESPERANDO);
+    }
+
+    static EstadoPuente decodificar(uint64_t palabra) {
+        EstadoPuente e;
+        for (int d = 0; d < 2; d++) {
+            e.en_puente[d] = (palabra >> (DESP_PUENTE + d * BITS_PUENTE)) & MASCARA_PUENTE;
+            e.seguidos[d] = (palabra >> (DESP_SEGUIDOS + d * BITS_PUENTE)) & MASCARA_PUENTE;
+            e.esperando[d] = (palabra >> (DESP_ESPERANDO + d * BITS_ESPERANDO)) & MASCARA_ESPERANDO;
+        }
+        e.turno = (Direccion)((palabra >> DESP_TURNO) & 3);
+        e.bloqueado = (palabra & BIT_BLOQUEADO) != 0;
+        return e;
+    }
+
+    uint64_t codificar() const {
+        uint64_t palabra = 0;
+        for (int d = 0; d < 2; d++) {
+            palabra |= (uint64_t)en_puente[d] << (DESP_PUENTE + d * BITS_PUENTE);
+            palabra |= (uint64_t)seguidos[d] << (DESP_SEGUIDOS + d * BITS_PUENTE);
+            palabra |= (uint64_t)esperando[d] << (DESP_ESPERANDO + d * BITS_ESPERANDO);
+        }
+        palabra |= (uint64_t)turno << DESP_TURNO;
+        if (bloqueado) palabra |= BIT_BLOQUEADO;
+        return palabra;
+    }
+};
+
+static_assert(MAX_COCHES_SIMULTANEOS <= (int)EstadoPuente::MASCARA_PUENTE, "MAX_COCHES_SIMULTANEOS no cabe en EstadoPuente");
+static_assert(MAX_COCHES_SEGUIDOS <= (int)EstadoPuente::MASCARA_PUENTE, "MAX_COCHES_SEGUIDOS no cabe en EstadoPuente");
+
+// Politicas de paso. El monitor delega en su politica (parametro de
+// plantilla, resuelto al compilar para que el predicado quede en linea) dos
+// decisiones:
+//   cupo       cuantos coches de mi_dir pueden entrar aun seguidos mientras el
+//              otro sentido tiene coches esperando
+//   al_vaciar  a quien pasa el turno cuando sale el ultimo coche de mi_dir
+//              (se llama dentro del bucle CAS: no debe modificar nada fuera de e)
+// y le avisa de las admisiones y de los cambios en el frente de los aparcados
+// por si lleva estado propio. Las reglas fijas (capacidad, un solo sentido a
+// la vez, bloqueo) siguen en el monitor.
+
+inline Direccion sentido_opuesto(Direccion dir) {
+    return (dir == IZQUIERDA) ? DERECHA : IZQUIERDA;
+}
+
+// Orden de un coche aparcado (Coche::orden_aparcado) cuando no hay ninguno.
+const uint64_t SIN_ORDEN = UINT64_MAX;
+
+// Avisos vacios y cierre de racha comun. Al vaciarse el puente el turno pasa al
+// otro sentido si tiene cola y su cupo, con la racha a cero, no es nulo; si no
+// se queda en mi_dir. Las rachas de las politicas derivadas empiezan de cero
+// en cada cambio.
+template <class Derivada>
+struct PoliticaBase {
+    void al_admitir(Direccion, int, bool) {}
+    void al_frente(Direccion, uint64_t) {}
+
+    static void ceder_turno(EstadoPuente& e, Direccion mi_dir, bool otra_puede) {
+        Direccion otra_dir = sentido_opuesto(mi_dir);
+        e.seguidos[mi_dir] = 0;
+        if (e.esperando[otra_dir] == 0) {
+            e.turno = NINGUNO;
+            e.seguidos[otra_dir] = 0;
+        } else if (e.esperando[mi_dir] == 0 || otra_puede) {
+            e.turno = otra_dir;
+            e.seguidos[otra_dir] = 0;
+        } else {
+            e.turno = mi_dir;
+        }
+    }
+
+    void al_vaciar(EstadoPuente& e, Direccion mi_dir, const LimitesPuente& l) const {
+        Direccion otra_dir = sentido_opuesto(mi_dir);
+        EstadoPuente siguiente = e;
+        siguiente.seguidos[otra_dir] = 0;
+        ceder_turno(e, mi_dir, static_cast<const Derivada*>(this)->cupo(siguiente, otra_dir, l) > 0);
+    }
+};
+
+// Regla original: el turno es del primero que llega y, si el otro sentido
+// espera, se cede tras max_seguidos coches.
+struct PoliticaRacha : PoliticaBase<PoliticaRacha> {
+    static constexpr const char* nombre = "racha";
+
+    int cupo(const EstadoPuente& e, Direccion mi_dir, const LimitesPuente& l) const {
+        return l.max_seguidos - e.seguidos[mi_dir];
+    }
+
+    void al_vaciar(EstadoPuente& e, Direccion mi_dir, const LimitesPuente& l) const {
+        Direccion otra_dir = sentido_opuesto(mi_dir);
+        if (e.seguidos[mi_dir] >= l.max_seguidos) {
+            e.seguidos[mi_dir] = 0;
+        }
+        if (e.esperando[otra_dir] > 0) {
+            e.turno = otra_dir;
+        } else {
+            e.turno = NINGUNO;
+            e.seguidos[mi_dir] = 0;
+        }
+    }
+};
+
+// Un coche por turno mientras haya cola en los dos sentidos.
+struct PoliticaAlternancia : PoliticaBase<PoliticaAlternancia> {
+    static constexpr const char* nombre = "alternancia";
+
+    int cupo(const EstadoPuente& e, Direccion mi_dir, const LimitesPuente&) const {
+        return 1 - e.seguidos[mi_dir];
+    }
+};
+
+// La racha crece con la proporcion entre colas: max_seguidos si son iguales,
+// mas si la propia es mayor y al menos un coche si es menor.
+struct PoliticaProporcional : PoliticaBase<PoliticaProporcional> {
+    static constexpr const char* nombre = "proporcional";
+
+    int cupo(const EstadoPuente& e, Direccion mi_dir, const LimitesPuente& l) const {
+        int otra = std::max(1, e.esperando[sentido_opuesto(mi_dir)]);
+        int64_t racha = ((int64_t)l.max_seguidos * e.esperando[mi_dir] + otra / 2) / otra;
+        racha = std::max<int64_t>(1, std::min<int64_t>(racha, EstadoPuente::MASCARA_PUENTE));
+        return (int)racha - e.seguidos[mi_dir];
+    }
+};
+
+// El turno pasa al sentido cuyo primer coche aparcado lleva mas tiempo
+// esperando y dura como mucho max_seguidos coches. El monitor avisa con
+// al_frente, con mtx tomado, del orden del primer aparcado de cada sentido;
+// los aparcados de un sentido estan en orden de solicitud, asi que ese es el
+// mas antiguo. Un sentido sin aparcados (sus coches aun no han pedido paso)
+// no adelanta al que los tiene.
+struct PoliticaMayorEspera : PoliticaBase<PoliticaMayorEspera> {
+    static constexpr const char* nombre = "mayor-espera";
+
+    std::atomic<uint64_t> frente[2] = {SIN_ORDEN, SIN_ORDEN};
+
+    int cupo(const EstadoPuente& e, Direccion mi_dir, const LimitesPuente& l) const {
+        return l.max_seguidos - e.seguidos[mi_dir];
+    }
+
+    void al_frente(Direccion dir, uint64_t orden) {
+        frente[dir] = orden;
+    }
+
+    void al_vaciar(EstadoPuente& e, Direccion mi_dir, const LimitesPuente&) const {
+        uint64_t mio = frente[mi_dir];
+        uint64_t otro = frente[sentido_opuesto(mi_dir)];
+        ceder_turno(e, mi_dir, mio == SIN_ORDEN || otro < mio);
+    }
+};
+
+// Reparto ponderado: mientras los dos sentidos tienen cola, los coches que
+// cruza cada uno tienden a la proporcion de sus pesos. El servicio se mide en
+// coches por unidad de peso (pesos normalizados a media 1) y un sentido sigue
+// entrando mientras no aventaje al otro en max_seguidos / 2 unidades, asi que
+// con pesos iguales las rachas son de unos max_seguidos coches. Los
+// contadores vuelven a cero cuando un coche entra sin competencia.
+struct PoliticaReparto : PoliticaBase<PoliticaReparto> {
+    static constexpr const char* nombre = "reparto";
+
+    double peso[2] = {1.0, 1.0};
+    std::atomic<uint64_t> servidos[2] = {0, 0};
+
+    void fijar_pesos(double izquierda, double derecha) {
+        double media = (izquierda + derecha) / 2;
+        peso[IZQUIERDA] = izquierda / media;
+        peso[DERECHA] = derecha / media;
+    }
+
+    int cupo(const EstadoPuente&, Direccion mi_dir, const LimitesPuente& l) const {
+        Direccion otra_dir = sentido_opuesto(mi_dir);
+        double servicio_otra = servidos[otra_dir] / peso[otra_dir];
+        double tope = std::ceil((servicio_otra + l.max_seguidos / 2.0) * peso[mi_dir]);
+        double cupo = tope - (double)servidos[mi_dir];
+        return (int)std::max(0.0, std::min(cupo, (double)EstadoPuente::MASCARA_PUENTE));
+    }
+
+    void al_admitir(Direccion dir, int n, bool otra_espera) {
+        if (otra_espera) {
+            servidos[dir] += n;
+        } else {
+            servidos[IZQUIERDA] = 0;
+            servidos[DERECHA] = 0;
+        }
+    }
+};
+
+// Politica: una de las Politica* de arriba; MonitorPuente usa la regla
+// original.
+template <class Politica>
+class MonitorConPolitica {
+private:
+    std::atomic<uint64_t> estado;
+    LimitesPuente limites;
+
+    std::atomic<bool> sensor_izq_ok{true};     
+    std::atomic<bool> sensor_der_ok{true};     
+    std::atomic<bool> barrera_izq_ok{true};    
+    std::atomic<bool> barrera_der_ok{true};    
+    
+    std::string causa_bloqueo = "N/A"; 
+
+    // Coches de cada sentido que esperan en el camino lento, en orden de
+    // llegada. Mientras haya alguno, los que llegan no usan el camino rapido y
+    // sale_coche sabe que tiene que despachar.
+    std::atomic<int> en_espera[2] = {0, 0};
+    std::deque<Coche*> aparcados[2];
+    uint64_t siguiente_orden = 0;         // para Coche::orden_aparcado, con mtx
+
+    // Se llama con mtx tomado cada vez que cambia el frente de aparcados[dir].
+    void publicar_frente(Direccion dir) {
+        politica.al_frente(dir, aparcados[dir].empty() ? SIN_ORDEN : aparcados[dir].front()->orden_aparcado);
+    }
+
+    bool componentes_ok(Direccion dir) const {
+        return (dir == IZQUIERDA) ? (sensor_izq_ok && barrera_izq_ok) : (sensor_der_ok && barrera_der_ok);
+    }
+
+    // Cupo de la politica acotado a lo que cabe en seguidos. El sentido que
+    // tiene (o puede tomar) el turno con el puente vacio siempre puede meter
+    // un coche, para que ninguna politica deje a los dos sentidos parados.
+    int cupo_seguidos(const EstadoPuente& e, Direccion mi_dir) const {
+        int cupo = politica.cupo(e, mi_dir, limites);
+        if ((e.turno == mi_dir || e.turno == NINGUNO) && e.en_puente[mi_dir] == 0) {
+            cupo = std::max(cupo, 1);
+        }
+        return std::min(cupo, (int)EstadoPuente::MASCARA_PUENTE - e.seguidos[mi_dir]);
+    }
+
+    bool puede_pasar(const EstadoPuente& e, Direccion mi_dir) const;
+    MotivoRechazo motivo_rechazo(const Coche* coche) const;
+    void rechazar(Coche* coche, MotivoRechazo motivo);
+    bool intentar_admitir(Coche* coche);
+    int admitir_convoy(Direccion dir);
+    bool evaluar_paso(Coche* coche);
+    void despachar_aparcados();
+    void retirar_aparcado(Coche* coche);
+
+    void registrar(TipoRegistro tipo, const Coche* coche, int valor0 = 0, int valor1 = 0, MotivoRechazo motivo = SIN_RECHAZO, int valor2 = 0) {
+        if (!sistema_en_pausa) {
+            registrar_evento(tipo, coche, valor0, valor1, motivo, valor2);
+        }
+    }
+
+    // Se llaman con mtx tomado, al poner y quitar BIT_BLOQUEADO.
+    void empezar_bloqueo() {
+        metricas.sumar(MET_BLOQUEOS);
+        inicio_bloqueo_ns = reloj_monotonico_ns();
+    }
+
+    void terminar_bloqueo() {
+        int64_t inicio = inicio_bloqueo_ns.exchange(0);
+        if (inicio != 0) ns_bloqueado += reloj_monotonico_ns() - inicio;
+    }
+
+    void trazar(TipoTraza tipo, const Coche* coche) {
+        EventoTraza ev = {};
+        ev.tiempo_us = reloj_traza ? reloj_traza() : reloj_monotonico_ns() / 1000;
+        ev.tipo = tipo;
+        ev.coche = -1;
+        if (coche) {
+            ev.coche = coche->id;
+            ev.direccion = coche->direccion;
+            ev.peso_toneladas = (uint8_t)std::min(coche->peso_toneladas, 255);
+            ev.altura_metros = (uint8_t)std::min(coche->altura_metros, 255);
+            ev.falla = coche->falla_mecanica_grave;
+        }
+        traza->publicar(ev);
+    }
+public:
+    std::mutex mtx; 
+    std::condition_variable cv_apagado; 
+    
+    std::atomic<int> total_cruzados{0};
+    std::atomic<int> total_generados{0};
+    std::atomic<int> cambios_turno{0};
+    std::atomic<bool> sistema_activo;
+
+    // Contadores de /metrics en fragmentos por hilo: sumarlos no comparte
+    // lineas de cache entre hilos y leerlos no toma mtx.
+    enum ContadorMetrica {
+        MET_LLEGADAS,                                   // + sentido
+        MET_CRUCES = MET_LLEGADAS + 2,                  // + sentido
+        MET_RECHAZOS = MET_CRUCES + 2,                  // + motivo - RECHAZO_PESO
+        MET_CAMBIOS_TURNO = MET_RECHAZOS + 3,
+        MET_BLOQUEOS,
+        NUM_METRICAS
+    };
+    ContadoresFragmentados<NUM_METRICAS> metricas;
+    std::atomic<int64_t> inicio_bloqueo_ns{0};               // 0 si no esta bloqueado
+    std::atomic<uint64_t> ns_bloqueado{0};                   // bloqueos ya terminados
+    std::atomic<bool> sistema_en_pausa; 
+
+    Politica politica;
+
+    // Recibe los coches aparcados sin hueco de espera propio (pool, corrutinas,
+    // eventos) que el monitor admite o rechaza. Se invoca con mtx tomado.
+    std::function<void(Coche*)> despachador;
+
+    // Tiempo con mtx tomado en los caminos de admision y salida. Solo se mide
+    // si medir_mutex esta activo.
+    bool medir_mutex = false;
+    std::atomic<uint64_t> ns_mutex{0};
+    std::atomic<uint64_t> tomas_mutex{0};
+    std::atomic<uint64_t> cas_admision{0};
+
+    // Latencias en microsegundos de los coches que cruzaron, por sentido:
+    // espera en cola (llegada -> inicio de cruce) y cruce (inicio -> salida).
+    HistogramaConcurrente latencia_espera[2];
+    HistogramaConcurrente latencia_cruce[2];
+
+    // Si no es nulo cada transicion se graba en la traza. Las entradas se
+    // graban antes de aplicarse y las decisiones despues, para que el orden del
+    // fichero respete la causalidad entre hilos. reloj_traza sustituye al reloj
+    // monotono (el simulador de eventos pone su tiempo virtual). La traza no
+    // descarta: con su buffer lleno, trazar espera con mtx tomado.
+    TrazaPuente* traza = nullptr;
+    std::function<int64_t()> reloj_traza;
+
+    class CerrojoMedido {
+        MonitorConPolitica& m;
+        std::lock_guard<std::mutex> lock;
+        std::chrono::steady_clock::time_point inicio;
+    public:
+        explicit CerrojoMedido(MonitorConPolitica& m) : m(m), lock(m.mtx) {
+            if (m.medir_mutex) inicio = std::chrono::steady_clock::now();
+        }
+        ~CerrojoMedido() {
+            if (m.medir_mutex) {
+                m.ns_mutex += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - inicio).count();
+                m.tomas_mutex++;
+            }
+        }
+    };
+
+    // Los limites de coches en el puente y seguidos se acotan a lo que cabe en
+    // EstadoPuente.
+    explicit MonitorConPolitica(const LimitesPuente& l = LimitesPuente()) : limites(l) {
+        int maximo = (int)EstadoPuente::MASCARA_PUENTE;
+        limites.max_simultaneos = std::max(1, std::min(limites.max_simultaneos, maximo));
+        limites.max_seguidos = std::max(1, std::min(limites.max_seguidos, maximo));
+
+        EstadoPuente inicial = {{0, 0}, {0, 0}, {0, 0}, NINGUNO, false};
+        estado = inicial.codificar();
+        sistema_activo = true;
+        sistema_en_pausa = false;
+        if (registro_habilitado) {
+            std::cerr << "[" << hora_actual() << "] Monitor del puente inicializado correctamente" << std::endl;
+        }
+    }
+
+    EstadoPuente leer_estado() const {
+        return EstadoPuente::decodificar(estado.load());
+    }
+
+    void set_sensor_ok(Direccion dir, bool estado) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (dir == IZQUIERDA) {
+            sensor_izq_ok = estado;
+        } else {
+            sensor_der_ok = estado;
+        }
+    }
+
+    void set_barrera_ok(Direccion dir, bool estado) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (dir == IZQUIERDA) {
+            barrera_izq_ok = estado;
+        } else {
+            barrera_der_ok = estado;
+        }
+    }
+    
+    std::string get_causa_bloqueo() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return causa_bloqueo;
+    }
+
+    void mostrar_estado() {
+        std::lock_guard<std::mutex> lock(mtx);
+        EstadoPuente e = leer_estado();
+        std::cout << "\n";
+        std::cout << "============================================================\n";
+        std::cout << "               ESTADO ACTUAL DEL PUENTE DUERO               \n";
+        std::cout << "------------------------------------------------------------\n";
+        std::cout << "ESTADO GLOBAL:         " << (e.bloqueado ? "BLOQUEADO/SUSPENDIDO" : "OPERATIVO") << "\n";
+        if (e.bloqueado) {
+             std::cout << "CAUSA DEL BLOQUEO:     " << causa_bloqueo << "\n";
+        }
+        std::cout << "Turno actual:          " << direccion_str(e.turno) << "\n";
+        std::cout << "Componentes IZQ:       Sensor (" << (sensor_izq_ok ? "OK" : "FALLA") << ") | Barrera (" << (barrera_izq_ok ? "OK" : "FALLA") << ")\n";
+        std::cout << "Componentes DER:       Sensor (" << (sensor_der_ok ? "OK" : "FALLA") << ") | Barrera (" << (barrera_der_ok ? "OK" : "FALLA") << ")\n";
+        std::cout << "Coches en puente IZQ:  " << e.en_puente[IZQUIERDA] << "\n";
+        std::cout << "Coches en puente DER:  " << e.en_puente[DERECHA] << "\n";
+        std::cout << "Coches esperando IZQ:  " << e.esperando[IZQUIERDA] << "\n";
+        std::cout << "Coches esperando DER:  " << e.esperando[DERECHA] << "\n";
+        std::cout << "Total cruzados:        " << total_cruzados << "\n";
+        std::cout << "============================================================\n";
+        std::cout << "\n";
+    }
+
+    void llega_cola(Coche* coche);
+    void pasa_coche(Coche* coche);
+    bool intentar_pasar(Coche* coche);
+    bool pasa_coche_o_aparcar(Coche* coche);
+    void sale_coche(Coche* coche);
+    void sale_coche(Coche* coche, std::chrono::steady_clock::time_point salida);
+
+    // Deja de grabar y espera a que lo publicado llegue al fichero; despues el
+    // escritor puede destruirse. El hilo de intervencion sigue suelto (detach)
+    // al salir de main, pero solo traza con mtx tomado y ya vera nullptr.
+    void soltar_traza() {
+        TrazaPuente* anterior;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            anterior = traza;
+            traza = nullptr;
+        }
+        if (anterior) anterior->vaciar();
+    }
+
+    void iniciar_bloqueo_puente(const std::string& causa) {
+        std::lock_guard<std::mutex> lock(mtx); 
+        if (traza) trazar(TRAZA_BLOQUEO, nullptr);
+        uint64_t previo = estado.fetch_or(EstadoPuente::BIT_BLOQUEADO);
+        if (!(previo & EstadoPuente::BIT_BLOQUEADO)) empezar_bloqueo();
+        causa_bloqueo = causa;
+    }
+
+    bool is_puente_bloqueado() {
+        return (estado.load() & EstadoPuente::BIT_BLOQUEADO) != 0;
+    }
+
+    void reanudar_sistema() {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (traza) trazar(TRAZA_REANUDACION, nullptr);
+        uint64_t previo = estado.fetch_and(~EstadoPuente::BIT_BLOQUEADO);
+        if (previo & EstadoPuente::BIT_BLOQUEADO) terminar_bloqueo();
+        sistema_en_pausa = false;
+        causa_bloqueo = "N/A"; 
+
+        sensor_izq_ok = true;
+        sensor_der_ok = true;
+        barrera_izq_ok = true;
+        barrera_der_ok = true;
+        
+        despachar_aparcados();
+    }
+
+    // Despierta a todos los hilos dormidos en el monitor para que vean que el
+    // sistema se apaga.
+    void despertar_esperas() {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto& cola : aparcados) {
+            for (Coche* coche : cola) {
+                if (coche->espera) coche->espera->cv.notify_one();
+            }
+        }
+    }
+};
+
+typedef MonitorConPolitica<PoliticaRacha> MonitorPuente;
+
+inline std::string texto_rechazo(MotivoRechazo motivo, int valor) {
+    switch (motivo) {
+        case RECHAZO_PESO: return "Infracción de Peso (" + std::to_string(valor) + "T)";
+        case RECHAZO_ALTURA: return "Infracción de Altura (" + std::to_string(valor) + "m)";
+        case RECHAZO_FALLA: return "Falla Mecánica Grave (Accidente)";
+        default: return "";
+    }
+}
+
+inline void formatear_registro(const RegistroMonitor& r, std::string& salida) {
+    const char* hora = hora_de(r.instante_ms / 1000);
+    salida += '[';
+    salida += hora;
+    salida += "] ";
+    std::string id = std::to_string(r.coche);
+    Direccion dir = (Direccion)r.direccion;
+    switch (r.tipo) {
+        case REG_TEXTO:
+            salida += r.texto;
+            break;
+        case REG_SENSOR_ENTRADA:
+            salida += "[SENSOR ENTRADA] Coche " + id + " detectado en cola " + direccion_str(dir) + " (esperando: " + std::to_string(r.valor[0]) + ")";
+            break;
+        case REG_EN_COLA:
+            salida += "[ESTADO BLOQUEADO] Coche " + id + " entra en cola " + direccion_str(dir);
+            break;
+        case REG_PERMISO:
+            salida += "[TRANSICIÓN: LISTO -> EJECUCIÓN] Coche " + id + " obtiene permiso.\n";
+            salida += '[';
+            salida += hora;
+            salida += "] ";
+            salida += "[BARRERA ABRE] Coche " + id + " ENTRA desde " + direccion_str(dir) +
+                      " (en puente: " + std::to_string(r.valor[0]) + ", seguidos: " +
+                      std::to_string(r.valor[1]) + "/" + std::to_string(r.valor[2]) + ")";
+            break;
+        case REG_DETENIDO:
+            salida += "Coche " + id + " DETENIDO. Razón: " + texto_rechazo((MotivoRechazo)r.motivo, r.valor[0]);
+            break;
+        case REG_SUSPENSION:
+            salida += "Accidente/Infracción de vehículo (" + texto_rechazo((MotivoRechazo)r.motivo, r.valor[0]) + ") fuerza la SUSPENSIÓN del sistema.";
+            break;
+        case REG_SALIDA:
+            salida += "[TRANSICIÓN: EJECUCIÓN -> TERMINADO] Coche " + id + " SALE";
+            break;
+        case REG_CAMBIO_TURNO:
+            salida += "Cambio de turno a " + direccion_str((Direccion)r.valor[0]);
+            break;
+    }
+    salida += "\n";
+}
+
+inline void publicar_registro(const RegistroMonitor& r) {
+    publicando_registro.fetch_add(1);
+    RegistroAsincrono<RegistroMonitor>* registro = registro_eventos.load();
+    if (registro) {
+        registro->publicar(r);
+        publicando_registro.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+    publicando_registro.fetch_sub(1, std::memory_order_release);
+    std::string linea;
+    formatear_registro(r, linea);
+    std::cerr << linea;
+}
+
+inline void registrar_evento(TipoRegistro tipo, const Coche* coche, int valor0, int valor1, MotivoRechazo motivo, int valor2) {
+    RegistroMonitor r = {};
+    r.instante_ms = reloj_ms();
+    r.coche = coche->id;
+    r.valor[0] = valor0;
+    r.valor[1] = valor1;
+    r.valor[2] = valor2;
+    r.tipo = tipo;
+    r.direccion = coche->direccion;
+    r.motivo = motivo;
+    publicar_registro(r);
+}
+
+template <class Politica>
+void MonitorConPolitica<Politica>::llega_cola(Coche* coche) {
+    if (traza) trazar(TRAZA_LLEGADA, coche);
+    uint64_t previo = estado.fetch_add(EstadoPuente::un_esperando(coche->direccion));
+    metricas.sumar(MET_LLEGADAS + (int)coche->direccion);
+    if (registro_habilitado) {
+        registrar(REG_SENSOR_ENTRADA, coche, EstadoPuente::decodificar(previo).esperando[coche->direccion] + 1);
+    }
+}
+
+template <class Politica>
+bool MonitorConPolitica<Politica>::puede_pasar(const EstadoPuente& e, Direccion mi_dir) const {
+    Direccion otra_dir = (mi_dir == IZQUIERDA) ? DERECHA : IZQUIERDA;
+
+    bool no_bloqueado = !e.bloqueado;
+    bool es_mi_turno = (e.turno == mi_dir || e.turno == NINGUNO);
+    bool puente_libre = (e.en_puente[otra_dir] == 0);
+    bool hay_capacidad = (e.en_puente[mi_dir] < limites.max_simultaneos);
+    bool puede_pasar_seguido = true;
+    if (e.esperando[otra_dir] > 0) {
+        puede_pasar_seguido = (cupo_seguidos(e, mi_dir) > 0);
+    }
+
+    return no_bloqueado && es_mi_turno && puente_libre && hay_capacidad && puede_pasar_seguido;
+}
+
+template <class Politica>
+MotivoRechazo MonitorConPolitica<Politica>::motivo_rechazo(const Coche* coche) const {
+    if (coche->peso_toneladas > limites.max_peso_ton) return RECHAZO_PESO;
+    if (coche->altura_metros > limites.max_altura_m) return RECHAZO_ALTURA;
+    if (coche->falla_mecanica_grave) return RECHAZO_FALLA;
+    return SIN_RECHAZO;
+}
+
+// Se llama con mtx tomado.
+template <class Politica>
+void MonitorConPolitica<Politica>::rechazar(Coche* coche, MotivoRechazo motivo) {
+    int valor = (motivo == RECHAZO_PESO) ? coche->peso_toneladas : coche->altura_metros;
+    if (registro_habilitado) {
+        registrar(REG_DETENIDO, coche, valor, 0, motivo);
+    }
+
+    coche->estado = RECHAZADO;
+    if (traza) trazar(TRAZA_RECHAZO, coche);
+    metricas.sumar(MET_RECHAZOS + (motivo - RECHAZO_PESO));
+    uint64_t previo = estado.fetch_sub(EstadoPuente::un_esperando(coche->direccion));
+    previo = estado.fetch_or(EstadoPuente::BIT_BLOQUEADO);
+
+    if (!(previo & EstadoPuente::BIT_BLOQUEADO)) {
+        empezar_bloqueo();
+        sistema_en_pausa = true; 
+        causa_bloqueo = texto_rechazo(motivo, valor); 
+        if (registro_habilitado) {
+            registrar(REG_SUSPENSION, coche, valor, 0, motivo);
+        }
+    }
+}
+
+// Camino rapido de la admision: un CAS sobre la palabra de estado. Devuelve
+// false sin modificar nada si las reglas no dejan pasar al coche ahora.
+template <class Politica>
+bool MonitorConPolitica<Politica>::intentar_admitir(Coche* coche) {
+    Direccion mi_dir = coche->direccion;
+    Direccion otra_dir = (mi_dir == IZQUIERDA) ? DERECHA : IZQUIERDA;
+
+    uint64_t actual = estado.load();
+    EstadoPuente e;
+    while (true) {
+        e = EstadoPuente::decodificar(actual);
+        if (!puede_pasar(e, mi_dir)) {
+            return false;
+        }
+
+        if (e.turno == NINGUNO) {
+            e.turno = mi_dir;
+        }
+        e.esperando[mi_dir]--;
+        e.en_puente[mi_dir]++;
+        if (e.esperando[otra_dir] > 0) {
+            e.seguidos[mi_dir]++;
+        }
+
+        if (medir_mutex) cas_admision++;
+        if (estado.compare_exchange_weak(actual, e.codificar())) {
+            break;
+        }
+    }
+    politica.al_admitir(mi_dir, 1, e.esperando[otra_dir] > 0);
+
+    coche->estado = CRUZANDO;
+    coche->tiempo_inicio_cruce = std::chrono::steady_clock::now();
+    if (traza) trazar(TRAZA_ADMISION, coche);
+
+    if (registro_habilitado) {
+        registrar(REG_PERMISO, coche, e.en_puente[mi_dir], e.seguidos[mi_dir], SIN_RECHAZO, limites.max_seguidos);
+    }
+    return true;
+}
+
+// Si el coche no puede pasar duerme en su propio hueco, en la cola FIFO de su
+// sentido; el monitor lo despierta solo cuando ya lo ha admitido, asi que no
+// hay despertares en vano ni rondas de reevaluacion del predicado.
+template <class Politica>
+void MonitorConPolitica<Politica>::pasa_coche(Coche* coche) {
+    if (registro_habilitado) {
+        registrar(REG_EN_COLA, coche);
+    }
+
+    EsperaCoche espera;
+    coche->espera = &espera;
+
+    if (!pasa_coche_o_aparcar(coche)) {
+        std::unique_lock<std::mutex> lock(mtx);
+        espera.cv.wait(lock, [&] { return espera.resuelto || !sistema_activo; });
+        if (!espera.resuelto) {
+            retirar_aparcado(coche);
+        }
+    }
+
+    coche->espera = nullptr;
+}
+
+// Se llama con mtx tomado.
+template <class Politica>
+void MonitorConPolitica<Politica>::retirar_aparcado(Coche* coche) {
+    std::deque<Coche*>& cola = aparcados[coche->direccion];
+    auto it = std::find(cola.begin(), cola.end(), coche);
+    if (it != cola.end()) {
+        bool era_frente = (it == cola.begin());
+        cola.erase(it);
+        en_espera[coche->direccion]--;
+        if (era_frente) publicar_frente(coche->direccion);
+    }
+}
+
+// Se llama con mtx tomado. Devuelve true si la solicitud del coche quedo
+// resuelta (admitido o rechazado).
+template <class Politica>
+bool MonitorConPolitica<Politica>::evaluar_paso(Coche* coche) {
+    if (coche->estado == RECHAZADO) {
+        return true;
+    }
+
+    if (!componentes_ok(coche->direccion)) {
+        return false;
+    }
+
+    MotivoRechazo motivo = motivo_rechazo(coche);
+    if (motivo != SIN_RECHAZO) {
+        rechazar(coche, motivo);
+        return true;
+    }
+
+    return intentar_admitir(coche);
+}
+
+// Version no bloqueante de pasa_coche: evalua las mismas reglas una sola vez y
+// devuelve false si el coche debe seguir en cola.
+template <class Politica>
+bool MonitorConPolitica<Politica>::intentar_pasar(Coche* coche) {
+    CerrojoMedido lock(*this);
+    return evaluar_paso(coche);
+}
+
+// Como intentar_pasar, pero si el coche no puede pasar queda aparcado en el
+// monitor (sin bloquear ningun hilo) y se entrega a `despachador` cuando
+// obtenga permiso. Los aparcados de un sentido se atienden en orden de llegada.
+template <class Politica>
+bool MonitorConPolitica<Politica>::pasa_coche_o_aparcar(Coche* coche) {
+    Direccion mi_dir = coche->direccion;
+    if (traza) trazar(TRAZA_SOLICITUD, coche);
+    if (en_espera[mi_dir] == 0 && componentes_ok(mi_dir) && motivo_rechazo(coche) == SIN_RECHAZO && intentar_admitir(coche)) {
+        return true;
+    }
+
+    CerrojoMedido lock(*this);
+    std::deque<Coche*>& cola = aparcados[mi_dir];
+    en_espera[mi_dir]++;
+    if (cola.empty() && evaluar_paso(coche)) {
+        en_espera[mi_dir]--;
+        return true;
+    }
+    coche->orden_aparcado = siguiente_orden++;
+    cola.push_back(coche);
+    if (cola.size() == 1) publicar_frente(mi_dir);
+    return false;
+}
+
+// Se llama con mtx tomado. Admite con un solo CAS el mayor prefijo de la cola
+// de `dir` que permiten las reglas (capacidad y coches seguidos) y devuelve
+// cuantos coches del frente quedaron resueltos. Un coche que debe ser
+// rechazado se resuelve solo, cuando llega al frente.
+template <class Politica>
+int MonitorConPolitica<Politica>::admitir_convoy(Direccion dir) {
+    std::deque<Coche*>& cola = aparcados[dir];
+    Coche* primero = cola.front();
+    if (primero->estado == RECHAZADO || !componentes_ok(dir) || motivo_rechazo(primero) != SIN_RECHAZO) {
+        return evaluar_paso(primero) ? 1 : 0;
+    }
+
+    int candidatos = 1;
+    while (candidatos < (int)cola.size() && candidatos < limites.max_simultaneos &&
+           cola[candidatos]->estado != RECHAZADO && motivo_rechazo(cola[candidatos]) == SIN_RECHAZO) {
+        candidatos++;
+    }
+
+    Direccion otra_dir = (dir == IZQUIERDA) ? DERECHA : IZQUIERDA;
+    uint64_t actual = estado.load();
+    EstadoPuente e;
+    int admitidos;
+    while (true) {
+        e = EstadoPuente::decodificar(actual);
+        if (!puede_pasar(e, dir)) {
+            return 0;
+        }
+
+        admitidos = std::min(candidatos, limites.max_simultaneos - e.en_puente[dir]);
+        if (e.esperando[otra_dir] > 0) {
+            admitidos = std::min(admitidos, cupo_seguidos(e, dir));
+        }
+
+        EstadoPuente nuevo = e;
+        if (nuevo.turno == NINGUNO) {
+            nuevo.turno = dir;
+        }
+        nuevo.esperando[dir] -= admitidos;
+        nuevo.en_puente[dir] += admitidos;
+        if (e.esperando[otra_dir] > 0) {
+            nuevo.seguidos[dir] += admitidos;
+        }
+
+        if (medir_mutex) cas_admision++;
+        if (estado.compare_exchange_weak(actual, nuevo.codificar())) {
+            break;
+        }
+    }
+    politica.al_admitir(dir, admitidos, e.esperando[otra_dir] > 0);
+
+    auto ahora = std::chrono::steady_clock::now();
+    for (int i = 0; i < admitidos; i++) {
+        Coche* coche = cola[i];
+        coche->estado = CRUZANDO;
+        coche->tiempo_inicio_cruce = ahora;
+        if (traza) trazar(TRAZA_ADMISION, coche);
+        if (registro_habilitado) {
+            int seguidos = e.seguidos[dir] + (e.esperando[otra_dir] > 0 ? i + 1 : 0);
+            registrar(REG_PERMISO, coche, e.en_puente[dir] + i + 1, seguidos, SIN_RECHAZO, limites.max_seguidos);
+        }
+    }
+    return admitidos;
+}
+
+// Se llama con mtx tomado.
+template <class Politica>
+void MonitorConPolitica<Politica>::despachar_aparcados() {
+    Direccion orden[2] = {IZQUIERDA, DERECHA};
+    if (leer_estado().turno == DERECHA) {
+        std::swap(orden[0], orden[1]);
+    }
+    for (Direccion dir : orden) {
+        std::deque<Coche*>& cola = aparcados[dir];
+        while (!cola.empty()) {
+            int resueltos;
+            if (admision_por_convoy) {
+                resueltos = admitir_convoy(dir);
+            } else {
+                resueltos = evaluar_paso(cola.front()) ? 1 : 0;
+            }
+            if (resueltos == 0) {
+                break;
+            }
+
+            for (int i = 0; i < resueltos; i++) {
+                Coche* coche = cola.front();
+                cola.pop_front();
+                en_espera[dir]--;
+                if (coche->espera) {
+                    coche->espera->resuelto = true;
+                    coche->espera->cv.notify_one();
+                } else {
+                    despachador(coche);
+                }
+            }
+            publicar_frente(dir);
+        }
+    }
+}
+
+template <class Politica>
+void MonitorConPolitica<Politica>::sale_coche(Coche* coche) {
+    sale_coche(coche, std::chrono::steady_clock::now());
+}
+
+// `salida` permite al simulador de eventos usar su reloj virtual.
+template <class Politica>
+void MonitorConPolitica<Politica>::sale_coche(Coche* coche, std::chrono::steady_clock::time_point salida) {
+    if (coche->estado != CRUZANDO) {
+        return;
+    }
+    if (traza) trazar(TRAZA_SALIDA, coche);
+
+    Direccion mi_dir = coche->direccion;
+    Direccion otra_dir = (mi_dir == IZQUIERDA) ? DERECHA : IZQUIERDA;
+
+    uint64_t actual = estado.load();
+    EstadoPuente e;
+    while (true) {
+        e = EstadoPuente::decodificar(actual);
+        e.en_puente[mi_dir]--;
+        if (e.en_puente[mi_dir] == 0) {
+            politica.al_vaciar(e, mi_dir, limites);
+        }
+        if (estado.compare_exchange_weak(actual, e.codificar())) {
+            break;
+        }
+    }
+
+    total_cruzados++;
+    metricas.sumar(MET_CRUCES + (int)mi_dir);
+    coche->estado = FINALIZADO;
+    coche->tiempo_salida = salida;
+    latencia_espera[mi_dir].registrar(std::chrono::duration_cast<std::chrono::microseconds>(coche->tiempo_inicio_cruce - coche->tiempo_llegada).count());
+    latencia_cruce[mi_dir].registrar(std::chrono::duration_cast<std::chrono::microseconds>(salida - coche->tiempo_inicio_cruce).count());
+    bool cambio_turno = (e.turno == otra_dir && e.en_puente[mi_dir] == 0);
+    if (cambio_turno) {
+        cambios_turno++;
+        metricas.sumar(MET_CAMBIOS_TURNO);
+        if (traza) trazar(TRAZA_CAMBIO_TURNO, coche);
+    }
+    if (registro_habilitado) {
+        registrar(REG_SALIDA, coche);
+        if (cambio_turno) {
+            registrar(REG_CAMBIO_TURNO, coche, otra_dir);
+        }
+    }
+
+    // Solo se toma el mutex si alguien duerme o esta aparcado: el CAS anterior
+    // y la lectura de en_espera son secuencialmente consistentes, asi que un
+    // coche que acaba de entrar al camino lento ya ve el estado nuevo.
+    if (en_espera[IZQUIERDA] == 0 && en_espera[DERECHA] == 0) {
+        return;
+    }
+
+    CerrojoMedido lock(*this);
+    despachar_aparcados();
+}
+
+#endif
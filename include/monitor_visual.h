@@ -0,0 +1,306 @@
+/*
+ * MONITOR DEL PUENTE (puente-visualV2)
+ * Monitor clásico con pthread_mutex_t y una variable condicional por sentido,
+ * con las reglas del caso de estudio: sentido único, turno, capacidad y límite
+ * de coches seguidos. Al final de cada procedimiento, con el mutex tomado,
+ * publica una instantánea del estado que el renderizado lee sin cerrojos.
+ *
+ * Los procedimientos solo tocan el monitor: el estado visual de cada coche,
+ * el log y los avisos al renderizado quedan en el programa. Se compila como C
+ * y como C++; todo es static inline para poder incluirlo desde varios
+ * ficheros.
+ */
+#ifndef MONITOR_VISUAL_H
+#define MONITOR_VISUAL_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define MAX_COCHES_SIMULTANEOS 3
+#define MAX_COCHES_SEGUIDOS 5
+
+// Direcciones
+enum Direccion { IZQUIERDA = 0, DERECHA = 1, NINGUNO = 2 };
+typedef enum Direccion Direccion;
+
+// ============================================================================
+// INSTANTÁNEA DEL MONITOR PARA EL RENDERIZADO
+// ============================================================================
+// Copia de los campos que se muestran, publicada con un seqlock. La escribe
+// solo quien tiene el mutex del monitor (un único escritor) al final de cada
+// procedimiento; el renderizado la copia sin cerrojos y reintenta si la
+// secuencia era impar o cambió durante la copia. Todos los campos son int
+// para poder copiarlos palabra a palabra con accesos atómicos.
+typedef struct {
+    int coches_en_puente[2];
+    int coches_esperando[2];
+    int coches_seguidos[2];
+    int turno;
+    int total_cruzados;
+    int total_generados;
+    int pausado;
+} EstadoVisible;
+
+#define PALABRAS_ESTADO (sizeof(EstadoVisible) / sizeof(int))
+
+typedef struct {
+    unsigned secuencia;     // impar mientras se escribe
+    EstadoVisible estado;
+} InstantaneaMonitor;
+
+// ============================================================================
+// ESTRUCTURA DEL MONITOR DEL PUENTE
+// ============================================================================
+typedef struct {
+    // Mutex principal del monitor (exclusión mutua)
+    pthread_mutex_t mutex;
+
+    // Variables condicionales (entradas del monitor)
+    pthread_cond_t cola_izquierda;
+    pthread_cond_t cola_derecha;
+
+    // Estado del puente
+    int coches_en_puente[2];      // Coches actualmente cruzando por lado
+    int coches_esperando[2];      // Coches esperando por lado (sensores)
+    int coches_seguidos[2];       // Contador de coches consecutivos
+    Direccion turno;              // Turno actual (IZQUIERDA, DERECHA, NINGUNO)
+
+    // Estadísticas
+    int total_cruzados;
+    int total_generados;
+
+    // Control de ejecución
+    bool sistema_activo;
+    bool pausado;
+
+    InstantaneaMonitor instantanea;
+} MonitorPuente;
+
+// Llamar con m->mutex tomado, después de modificar el estado.
+static inline void publicar_estado(MonitorPuente* m) {
+    EstadoVisible e;
+    for (int d = 0; d < 2; d++) {
+        e.coches_en_puente[d] = m->coches_en_puente[d];
+        e.coches_esperando[d] = m->coches_esperando[d];
+        e.coches_seguidos[d] = m->coches_seguidos[d];
+    }
+    e.turno = m->turno;
+    e.total_cruzados = m->total_cruzados;
+    e.total_generados = m->total_generados;
+    e.pausado = m->pausado;
+
+    unsigned secuencia = m->instantanea.secuencia;
+    __atomic_store_n(&m->instantanea.secuencia, secuencia + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    int* destino = (int*)&m->instantanea.estado;
+    const int* origen = (const int*)&e;
+    for (size_t i = 0; i < PALABRAS_ESTADO; i++) {
+        __atomic_store_n(&destino[i], origen[i], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&m->instantanea.secuencia, secuencia + 2, __ATOMIC_RELEASE);
+}
+
+static inline void leer_estado(MonitorPuente* m, EstadoVisible* e) {
+    const int* origen = (const int*)&m->instantanea.estado;
+    int* destino = (int*)e;
+    while (true) {
+        unsigned antes = __atomic_load_n(&m->instantanea.secuencia, __ATOMIC_ACQUIRE);
+        if (antes & 1) {
+            sched_yield();
+            continue;
+        }
+        for (size_t i = 0; i < PALABRAS_ESTADO; i++) {
+            destino[i] = __atomic_load_n(&origen[i], __ATOMIC_RELAXED);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&m->instantanea.secuencia, __ATOMIC_RELAXED) == antes) {
+            return;
+        }
+    }
+}
+
+// ============================================================================
+// INICIALIZACIÓN DEL MONITOR
+// ============================================================================
+
+static inline int monitor_inicializar(MonitorPuente* m) {
+    // Inicializar mutex (EXCLUSIÓN MUTUA)
+    if (pthread_mutex_init(&m->mutex, NULL) != 0) {
+        perror("Error al inicializar mutex del monitor");
+        return -1;
+    }
+
+    // Inicializar variables condicionales (ENTRADAS DEL MONITOR)
+    if (pthread_cond_init(&m->cola_izquierda, NULL) != 0) {
+        perror("Error al inicializar cola izquierda");
+        return -1;
+    }
+
+    if (pthread_cond_init(&m->cola_derecha, NULL) != 0) {
+        perror("Error al inicializar cola derecha");
+        return -1;
+    }
+
+    // Inicializar estado del puente
+    m->coches_en_puente[IZQUIERDA] = 0;
+    m->coches_en_puente[DERECHA] = 0;
+    m->coches_esperando[IZQUIERDA] = 0;
+    m->coches_esperando[DERECHA] = 0;
+    m->coches_seguidos[IZQUIERDA] = 0;
+    m->coches_seguidos[DERECHA] = 0;
+    m->turno = NINGUNO;
+    m->total_cruzados = 0;
+    m->total_generados = 0;
+    m->sistema_activo = true;
+    m->pausado = false;
+    m->instantanea.secuencia = 0;
+    publicar_estado(m);
+    return 0;
+}
+
+static inline void monitor_destruir(MonitorPuente* m) {
+    pthread_mutex_destroy(&m->mutex);
+    pthread_cond_destroy(&m->cola_izquierda);
+    pthread_cond_destroy(&m->cola_derecha);
+}
+
+// ============================================================================
+// PROCEDIMIENTOS DEL MONITOR (según caso de estudio)
+// ============================================================================
+
+/**
+ * PROCEDIMIENTO: llega_cola_izq / llega_cola_der
+ * Registra la llegada de un coche a la cola (SENSOR DE ENTRADA)
+ */
+static inline void monitor_llega_cola(MonitorPuente* m, Direccion mi_dir) {
+    pthread_mutex_lock(&m->mutex);
+
+    m->coches_esperando[mi_dir]++;
+    publicar_estado(m);
+
+    pthread_mutex_unlock(&m->mutex);
+}
+
+/**
+ * PROCEDIMIENTO: pasa_coche_izq / pasa_coche_der
+ * ENTRADA CONDICIONAL - El coche espera hasta poder cruzar
+ * Implementa las 4 condiciones del caso de estudio:
+ * 1. No hay coches del sentido contrario
+ * 2. No se supera la capacidad máxima
+ * 3. Se respeta el límite de coches seguidos
+ * 4. Se tiene el turno correspondiente
+ */
+static inline void monitor_pasa_coche(MonitorPuente* m, Direccion mi_dir) {
+    pthread_mutex_lock(&m->mutex);
+
+    Direccion otra_dir = (mi_dir == IZQUIERDA) ? DERECHA : IZQUIERDA;
+    pthread_cond_t* mi_cola = (mi_dir == IZQUIERDA) ?
+                              &m->cola_izquierda : &m->cola_derecha;
+
+    // ESPERAR hasta que se cumplan TODAS las condiciones
+    while (true) {
+        // Condición de pausa
+        if (m->pausado) {
+            pthread_cond_wait(mi_cola, &m->mutex);
+            continue;
+        }
+
+        // Condición 1: Verificar turno
+        bool es_mi_turno = (m->turno == mi_dir || m->turno == NINGUNO);
+
+        // Condición 2: No hay coches del otro lado (EXCLUSIÓN MUTUA)
+        bool puente_libre = (m->coches_en_puente[otra_dir] == 0);
+
+        // Condición 3: Capacidad no superada
+        bool hay_capacidad = (m->coches_en_puente[mi_dir] < MAX_COCHES_SIMULTANEOS);
+
+        // Condición 4: No se superó límite de seguidos (evitar INANICIÓN)
+        bool puede_pasar_seguido = true;
+        if (m->coches_esperando[otra_dir] > 0) {
+            puede_pasar_seguido = (m->coches_seguidos[mi_dir] < MAX_COCHES_SEGUIDOS);
+        }
+
+        // Si todas las condiciones se cumplen, puede pasar
+        if (es_mi_turno && puente_libre && hay_capacidad && puede_pasar_seguido) {
+            break;
+        }
+
+        // Si no puede pasar, espera en la cola condicional
+        pthread_cond_wait(mi_cola, &m->mutex);
+    }
+
+    // === SECCIÓN CRÍTICA: CRUZAR EL PUENTE ===
+
+    // Asignar turno si no hay ninguno
+    if (m->turno == NINGUNO) {
+        m->turno = mi_dir;
+    }
+
+    // Actualizar contadores
+    m->coches_esperando[mi_dir]--;
+    m->coches_en_puente[mi_dir]++;
+
+    // Incrementar contador de seguidos solo si hay cola en el otro lado
+    if (m->coches_esperando[otra_dir] > 0) {
+        m->coches_seguidos[mi_dir]++;
+    }
+
+    publicar_estado(m);
+
+    pthread_mutex_unlock(&m->mutex);
+}
+
+/**
+ * PROCEDIMIENTO: sale_coche_izq / sale_coche_der
+ * Registra la salida del coche (SENSOR DE SALIDA)
+ * Gestiona cambios de turno para evitar inanición
+ */
+static inline void monitor_sale_coche(MonitorPuente* m, Direccion mi_dir) {
+    pthread_mutex_lock(&m->mutex);
+
+    Direccion otra_dir = (mi_dir == IZQUIERDA) ? DERECHA : IZQUIERDA;
+
+    // Actualizar contadores
+    m->coches_en_puente[mi_dir]--;
+    m->total_cruzados++;
+
+    // Si soy el último de mi lado en el puente
+    if (m->coches_en_puente[mi_dir] == 0) {
+
+        // Reiniciar contador de seguidos si llegó al límite
+        if (m->coches_seguidos[mi_dir] >= MAX_COCHES_SEGUIDOS) {
+            m->coches_seguidos[mi_dir] = 0;
+        }
+
+        // Cambiar turno si hay coches esperando del otro lado (evitar INANICIÓN)
+        if (m->coches_esperando[otra_dir] > 0) {
+            m->turno = otra_dir;
+
+            // Despertar a los coches del otro lado
+            if (otra_dir == IZQUIERDA) {
+                pthread_cond_broadcast(&m->cola_izquierda);
+            } else {
+                pthread_cond_broadcast(&m->cola_derecha);
+            }
+        } else {
+            // Si no hay nadie esperando, liberar el turno
+            m->turno = NINGUNO;
+            m->coches_seguidos[mi_dir] = 0;
+        }
+    } else {
+        // Aún hay coches de mi lado, despertar al siguiente de mi cola
+        if (mi_dir == IZQUIERDA) {
+            pthread_cond_signal(&m->cola_izquierda);
+        } else {
+            pthread_cond_signal(&m->cola_derecha);
+        }
+    }
+    publicar_estado(m);
+
+    pthread_mutex_unlock(&m->mutex);
+}
+
+#endif
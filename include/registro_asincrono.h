@@ -0,0 +1,202 @@
+/*
+ * REGISTRO ASINCRONO
+ * Anillos lock-free por hilo (un productor, un consumidor) con registros de
+ * tamaño fijo. El hilo que registra solo copia el registro en su anillo; un
+ * hilo de fondo recorre los anillos, da formato al texto y lo escribe por
+ * lotes, fuera de cualquier sección crítica del programa.
+ *
+ * Uso:
+ *   RegistroAsincrono<MiRegistro> registro(formatear, STDERR_FILENO);
+ *   registro.publicar(r);     // desde cualquier hilo, nunca bloquea
+ *   registro.vaciar();        // espera a que todo lo publicado esté escrito
+ */
+#ifndef REGISTRO_ASINCRONO_H
+#define REGISTRO_ASINCRONO_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+template <class Registro, size_t CAPACIDAD = 256>
+class RegistroAsincrono {
+    static_assert((CAPACIDAD & (CAPACIDAD - 1)) == 0, "CAPACIDAD debe ser potencia de 2");
+    static const size_t MAX_ANILLOS = 1024;
+
+public:
+    // Agrega al buffer de salida el texto de un registro.
+    typedef void (*Formateador)(const Registro&, std::string&);
+
+private:
+    struct Anillo {
+        alignas(64) std::atomic<size_t> escritos{0};
+        alignas(64) std::atomic<size_t> leidos{0};
+        std::atomic<bool> en_uso{true};
+        Registro datos[CAPACIDAD];
+    };
+
+    // Libera el anillo del hilo cuando este termina, para que lo reutilice
+    // otro hilo (en el modo de un hilo por coche se crean miles). El anillo es
+    // compartido: si el registro se destruyo antes que el hilo (hilos sueltos,
+    // o el principal al salir), el ultimo propietario lo libera. El registro
+    // se reconoce por su id y no por su direccion, que puede reutilizarse.
+    struct Propietario {
+        uint64_t id = 0;
+        std::shared_ptr<Anillo> anillo;
+        void soltar() {
+            if (anillo) anillo->en_uso.store(false, std::memory_order_release);
+            anillo.reset();
+        }
+        ~Propietario() { soltar(); }
+    };
+
+    static uint64_t nuevo_id() {
+        static std::atomic<uint64_t> siguiente{1};
+        return siguiente.fetch_add(1);
+    }
+
+    const uint64_t id = nuevo_id();
+    Formateador formatear;
+    int fd_salida;
+
+    std::mutex mtx_anillos;
+    std::vector<std::shared_ptr<Anillo>> anillos;
+    std::atomic<size_t> num_anillos{0};
+    Anillo* tabla[MAX_ANILLOS] = {};
+
+    std::mutex mtx_consumidor;
+    std::condition_variable cv_consumidor;
+    std::atomic<bool> activo{true};
+    std::atomic<uint64_t> publicados{0};
+    std::atomic<uint64_t> escritos{0};
+    std::atomic<uint64_t> perdidos{0};
+    std::thread consumidor;
+
+    Anillo* anillo_propio() {
+        static thread_local Propietario propio;
+        if (propio.id == id && propio.anillo) {
+            return propio.anillo.get();
+        }
+        propio.soltar();
+
+        std::lock_guard<std::mutex> lock(mtx_anillos);
+        for (auto& a : anillos) {
+            if (!a->en_uso.load(std::memory_order_acquire)) {
+                a->en_uso.store(true, std::memory_order_relaxed);
+                propio.anillo = a;
+                break;
+            }
+        }
+        if (!propio.anillo && anillos.size() < MAX_ANILLOS) {
+            anillos.push_back(std::make_shared<Anillo>());
+            propio.anillo = anillos.back();
+            tabla[anillos.size() - 1] = propio.anillo.get();
+            num_anillos.store(anillos.size(), std::memory_order_release);
+        }
+        propio.id = id;
+        return propio.anillo.get();
+    }
+
+    // Devuelve cuántos registros se pasaron al buffer.
+    size_t drenar(std::string& buffer) {
+        size_t total = 0;
+        size_t n = num_anillos.load(std::memory_order_acquire);
+        for (size_t i = 0; i < n; i++) {
+            Anillo* anillo = tabla[i];
+            size_t leidos = anillo->leidos.load(std::memory_order_relaxed);
+            size_t escritos_anillo = anillo->escritos.load(std::memory_order_acquire);
+            while (leidos != escritos_anillo) {
+                formatear(anillo->datos[leidos & (CAPACIDAD - 1)], buffer);
+                leidos++;
+                total++;
+            }
+            anillo->leidos.store(leidos, std::memory_order_release);
+        }
+        return total;
+    }
+
+    void escribir(std::string& buffer) {
+        size_t enviado = 0;
+        while (enviado < buffer.size()) {
+            ssize_t n = ::write(fd_salida, buffer.data() + enviado, buffer.size() - enviado);
+            if (n <= 0) break;
+            enviado += n;
+        }
+        buffer.clear();
+    }
+
+    void bucle_consumidor() {
+        std::string buffer;
+        buffer.reserve(64 * 1024);
+        while (true) {
+            bool seguir = activo.load();
+            size_t n = drenar(buffer);
+            if (!buffer.empty()) {
+                escribir(buffer);
+            }
+            escritos += n;
+            if (!seguir) break;
+            if (n == 0) {
+                std::unique_lock<std::mutex> lock(mtx_consumidor);
+                cv_consumidor.wait_for(lock, std::chrono::milliseconds(5));
+            }
+        }
+    }
+
+public:
+    RegistroAsincrono(Formateador f, int fd) : formatear(f), fd_salida(fd) {
+        consumidor = std::thread(&RegistroAsincrono::bucle_consumidor, this);
+    }
+
+    ~RegistroAsincrono() {
+        activo = false;
+        cv_consumidor.notify_one();
+        consumidor.join();
+    }
+
+    // No bloquea nunca: si el anillo del hilo está lleno el registro se descarta
+    // y se cuenta en perdidos_total(). Si ya no quedan anillos libres se escribe
+    // directamente desde el hilo que llama.
+    void publicar(const Registro& r) {
+        Anillo* anillo = anillo_propio();
+        if (!anillo) {
+            escribir_directo(r);
+            return;
+        }
+        size_t escritos_anillo = anillo->escritos.load(std::memory_order_relaxed);
+        if (escritos_anillo - anillo->leidos.load(std::memory_order_acquire) >= CAPACIDAD) {
+            perdidos.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        anillo->datos[escritos_anillo & (CAPACIDAD - 1)] = r;
+        anillo->escritos.store(escritos_anillo + 1, std::memory_order_release);
+        publicados.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Formatea y escribe en el hilo que llama, sin pasar por los anillos.
+    void escribir_directo(const Registro& r) {
+        std::string buffer;
+        formatear(r, buffer);
+        escribir(buffer);
+    }
+
+    // Espera a que el hilo de fondo haya escrito todo lo publicado hasta ahora.
+    void vaciar() {
+        uint64_t objetivo = publicados.load();
+        while (escritos.load() < objetivo) {
+            cv_consumidor.notify_one();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    uint64_t perdidos_total() const { return perdidos.load(); }
+};
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ * RELOJ
+ * Marcas de tiempo para los registros sin reservar memoria ni llamar a
+ * localtime en cada linea. Cada hilo guarda el texto "HH:MM:SS" del ultimo
+ * segundo formateado y solo vuelve a consultar la zona horaria cuando cambia
+ * de minuto; dentro del minuto se actualizan los dos digitos de segundos.
+ *
+ * Los punteros devueltos apuntan a un buffer del propio hilo y son validos
+ * hasta la siguiente llamada a la misma funcion en ese hilo.
+ *
+ * Sirve tanto desde C como desde C++.
+ */
+#ifndef RELOJ_H
+#define RELOJ_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__cplusplus)
+#define RELOJ_TLS thread_local
+#else
+#define RELOJ_TLS _Thread_local
+#endif
+
+typedef struct {
+    time_t inicio_minuto;   // primer segundo del minuto ya formateado
+    time_t segundo;         // segundo que contiene texto
+    char texto[16];
+} CacheReloj;
+
+// Milisegundos desde la epoca (reloj de pared).
+static inline int64_t reloj_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Reloj monotono, para medir intervalos.
+static inline int64_t reloj_monotonico_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline int64_t reloj_monotonico_ms(void) {
+    return reloj_monotonico_ns() / 1000000;
+}
+
+static inline void reloj_actualizar(CacheReloj* cache, time_t segundos) {
+    if (segundos == cache->segundo) {
+        return;
+    }
+    if (cache->texto[0] == '\0' || segundos < cache->inicio_minuto || segundos >= cache->inicio_minuto + 60) {
+        struct tm tm_info;
+#ifdef _WIN32
+        localtime_s(&tm_info, &segundos);
+#else
+        localtime_r(&segundos, &tm_info);
+#endif
+        strftime(cache->texto, sizeof(cache->texto), "%H:%M:%S", &tm_info);
+        cache->inicio_minuto = segundos - tm_info.tm_sec;
+    } else {
+        int s = (int)(segundos - cache->inicio_minuto);
+        cache->texto[6] = (char)('0' + s / 10);
+        cache->texto[7] = (char)('0' + s % 10);
+    }
+    cache->segundo = segundos;
+}
+
+// "HH:MM:SS" de la hora local del segundo indicado.
+static inline const char* hora_de(time_t segundos) {
+    static RELOJ_TLS CacheReloj cache;
+    reloj_actualizar(&cache, segundos);
+    return cache.texto;
+}
+
+// "HH:MM:SS" de la hora local actual.
+static inline const char* hora_actual(void) {
+    return hora_de(time(NULL));
+}
+
+// "HH:MM:SS.mmm" de un instante en milisegundos desde la epoca.
+static inline const char* hora_ms_de(int64_t ms) {
+    static RELOJ_TLS CacheReloj cache;
+    static RELOJ_TLS char texto[16];
+    reloj_actualizar(&cache, (time_t)(ms / 1000));
+    int resto = (int)(ms % 1000);
+    memcpy(texto, cache.texto, 8);
+    texto[8] = '.';
+    texto[9] = (char)('0' + resto / 100);
+    texto[10] = (char)('0' + (resto / 10) % 10);
+    texto[11] = (char)('0' + resto % 10);
+    texto[12] = '\0';
+    return texto;
+}
+
+static inline const char* hora_actual_ms(void) {
+    return hora_ms_de(reloj_ms());
+}
+
+#endif
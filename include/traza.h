@@ -0,0 +1,191 @@
+/*
+ * TRAZA BINARIA
+ * Ficheros de registros de tamaño fijo precedidos de una cabecera.
+ *
+ * EscritorTraza: varios hilos publican a la vez sin cerrojos. Cada registro
+ * reserva su ranura con un fetch_add sobre un contador comun, de modo que el
+ * orden del fichero es un orden total compatible con happens-before entre los
+ * hilos que publican. Un hilo de fondo vuelca las ranuras en ese orden. Si el
+ * buffer se llena los productores esperan: no se pierden registros, porque
+ * una traza con huecos no se puede reproducir. La espera la paga quien
+ * publica con los cerrojos que tenga tomados (el monitor traza con su mtx):
+ * con un disco lento la traza frena al programa en lugar de perder datos.
+ * El escritor se queda con el descriptor y lo cierra al destruirse.
+ *
+ * LectorTraza: proyecta un fichero con mmap y valida la cabecera.
+ */
+#ifndef TRAZA_H
+#define TRAZA_H
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct CabeceraTraza {
+    char magico[8];
+    uint32_t version;
+    uint32_t tamano_registro;
+};
+
+inline bool escribir_todo(int fd, const void* datos, size_t tamano) {
+    const char* p = static_cast<const char*>(datos);
+    while (tamano > 0) {
+        ssize_t n = ::write(fd, p, tamano);
+        if (n <= 0) return false;
+        p += n;
+        tamano -= n;
+    }
+    return true;
+}
+
+template <class Registro, size_t CAPACIDAD = (1 << 16)>
+class EscritorTraza {
+    static_assert(std::is_trivially_copyable<Registro>::value, "Registro debe poder copiarse byte a byte");
+    static_assert((CAPACIDAD & (CAPACIDAD - 1)) == 0, "CAPACIDAD debe ser potencia de 2");
+
+    struct Ranura {
+        std::atomic<uint64_t> lista{0};     // secuencia + 1 cuando el registro esta escrito
+        Registro registro;
+    };
+
+    std::unique_ptr<Ranura[]> ranuras;
+    alignas(64) std::atomic<uint64_t> cabeza{0};
+    alignas(64) std::atomic<uint64_t> cola{0};
+    alignas(64) std::atomic<uint64_t> escritos{0};
+    std::atomic<bool> activo{true};
+    int fd;
+    std::thread escritor;
+
+    void bucle_escritor() {
+        const size_t LOTE = 4096;
+        std::unique_ptr<Registro[]> buffer(new Registro[LOTE]);
+        uint64_t siguiente = cola.load();
+        while (true) {
+            bool seguir = activo.load();
+            size_t n = 0;
+            while (n < LOTE) {
+                Ranura& r = ranuras[siguiente & (CAPACIDAD - 1)];
+                if (r.lista.load(std::memory_order_acquire) != siguiente + 1) break;
+                buffer[n++] = r.registro;
+                siguiente++;
+            }
+            if (n > 0) {
+                cola.store(siguiente, std::memory_order_release);
+                escribir_todo(fd, buffer.get(), n * sizeof(Registro));
+                escritos.store(siguiente, std::memory_order_release);
+                continue;
+            }
+            if (!seguir && siguiente == cabeza.load()) break;
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+    }
+
+public:
+    EscritorTraza(int fd_salida, const char magico[8], uint32_t version)
+        : ranuras(new Ranura[CAPACIDAD]), fd(fd_salida) {
+        CabeceraTraza cabecera;
+        memcpy(cabecera.magico, magico, sizeof(cabecera.magico));
+        cabecera.version = version;
+        cabecera.tamano_registro = sizeof(Registro);
+        escribir_todo(fd, &cabecera, sizeof(cabecera));
+        escritor = std::thread(&EscritorTraza::bucle_escritor, this);
+    }
+
+    ~EscritorTraza() {
+        activo = false;
+        escritor.join();
+        ::close(fd);
+    }
+
+    // Si hay CAPACIDAD registros sin volcar espera (cediendo la CPU) a que el
+    // hilo de fondo libere la ranura.
+    void publicar(const Registro& registro) {
+        uint64_t secuencia = cabeza.fetch_add(1);
+        while (secuencia - cola.load(std::memory_order_acquire) >= CAPACIDAD) {
+            std::this_thread::yield();
+        }
+        Ranura& r = ranuras[secuencia & (CAPACIDAD - 1)];
+        r.registro = registro;
+        r.lista.store(secuencia + 1, std::memory_order_release);
+    }
+
+    // Espera a que todo lo publicado hasta ahora este en el fichero.
+    void vaciar() {
+        uint64_t objetivo = cabeza.load();
+        while (escritos.load(std::memory_order_acquire) < objetivo) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+
+    uint64_t publicados() const { return cabeza.load(); }
+};
+
+template <class Registro>
+class LectorTraza {
+    static_assert(std::is_trivially_copyable<Registro>::value, "Registro debe poder copiarse byte a byte");
+
+    void* mapa = MAP_FAILED;
+    size_t tamano = 0;
+    size_t num_registros = 0;
+
+public:
+    LectorTraza() {}
+    LectorTraza(const LectorTraza&) = delete;
+    LectorTraza& operator=(const LectorTraza&) = delete;
+
+    ~LectorTraza() {
+        if (mapa != MAP_FAILED) munmap(mapa, tamano);
+    }
+
+    bool abrir(const char* ruta, const char magico[8], uint32_t version, std::string& error) {
+        int fd = ::open(ruta, O_RDONLY);
+        if (fd == -1) {
+            error = std::string("no se puede abrir ") + ruta + ": " + strerror(errno);
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(CabeceraTraza)) {
+            ::close(fd);
+            error = "fichero demasiado corto";
+            return false;
+        }
+        tamano = st.st_size;
+        mapa = mmap(nullptr, tamano, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapa == MAP_FAILED) {
+            error = std::string("mmap: ") + strerror(errno);
+            return false;
+        }
+        madvise(mapa, tamano, MADV_SEQUENTIAL);
+
+        const CabeceraTraza* cabecera = static_cast<const CabeceraTraza*>(mapa);
+        if (memcmp(cabecera->magico, magico, sizeof(cabecera->magico)) != 0) {
+            error = "no es un fichero de traza";
+            return false;
+        }
+        if (cabecera->version != version || cabecera->tamano_registro != sizeof(Registro)) {
+            error = "version o tamaño de registro incompatibles";
+            return false;
+        }
+        num_registros = (tamano - sizeof(CabeceraTraza)) / sizeof(Registro);
+        return true;
+    }
+
+    const Registro* registros() const {
+        return reinterpret_cast<const Registro*>(static_cast<const char*>(mapa) + sizeof(CabeceraTraza));
+    }
+
+    size_t cantidad() const { return num_registros; }
+};
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ * MonitorCompartido de sim_puenteV4 para el benchmark de admision (ver
+ * bench_admision.h). Se compila junto con src/bench-admision.cpp.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <sys/mman.h>
+
+#include "bench_admision.h"
+#include "monitor_compartido.h"
+
+using namespace std;
+
+namespace {
+
+// Como en V4, el monitor vive en memoria compartida; aqui lo usan hilos.
+class PuenteV4 : public PuenteBench {
+    MonitorCompartido* monitor;
+public:
+    PuenteV4() {
+        void* mem = mmap(NULL, sizeof(MonitorCompartido), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            perror("Error al crear la memoria compartida");
+            exit(1);
+        }
+        monitor = new (mem) MonitorCompartido();
+        inicializar_monitor_compartido(monitor);
+    }
+
+    ~PuenteV4() {
+        monitor->~MonitorCompartido();
+        munmap(monitor, sizeof(MonitorCompartido));
+    }
+
+    void entrar(int, int dir) override { entrar_puente(monitor, (Direccion)dir); }
+    void salir(int, int dir) override { salir_puente(monitor, (Direccion)dir); }
+};
+
+}
+
+unique_ptr<PuenteBench> crear_puente_V4() {
+    return make_unique<PuenteV4>();
+}
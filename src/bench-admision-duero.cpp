@@ -0,0 +1,44 @@
+/*
+ * MonitorPuente de sim-puente-duero para el benchmark de admision (ver
+ * bench_admision.h). Se compila junto con src/bench-admision.cpp.
+ */
+#include "bench_admision.h"
+#include "monitor_puente.h"
+
+using namespace std;
+
+namespace {
+
+class PuenteDuero : public PuenteBench {
+    unique_ptr<MonitorPuente> puente;
+    Coche coches[MAX_HILOS];
+public:
+    PuenteDuero() {
+        registro_habilitado = false;
+        puente = make_unique<MonitorPuente>();
+        for (int h = 0; h < MAX_HILOS; h++) {
+            Coche& c = coches[h];
+            c.id = h + 1;
+            c.peso_toneladas = MAX_PESO_TON;
+            c.altura_metros = MAX_ALTURA_M;
+            c.falla_mecanica_grave = false;
+        }
+    }
+
+    void entrar(int hilo, int dir) override {
+        Coche& c = coches[hilo];
+        c.direccion = (Direccion)dir;
+        c.estado = ESPERANDO;
+        c.tiempo_llegada = chrono::steady_clock::now();
+        puente->llega_cola(&c);
+        puente->pasa_coche(&c);
+    }
+
+    void salir(int hilo, int) override { puente->sale_coche(&coches[hilo]); }
+};
+
+}
+
+unique_ptr<PuenteBench> crear_puente_duero() {
+    return make_unique<PuenteDuero>();
+}
@@ -0,0 +1,39 @@
+/*
+ * Monitor de puente-visualV2 para el benchmark de admision (ver
+ * bench_admision.h). Se compila junto con src/bench-admision.cpp.
+ */
+#include <cstdlib>
+
+#include "bench_admision.h"
+#include "monitor_visual.h"
+
+using namespace std;
+
+namespace {
+
+class PuenteVisualV2 : public PuenteBench {
+    MonitorPuente monitor;
+public:
+    PuenteVisualV2() {
+        if (monitor_inicializar(&monitor) != 0) {
+            exit(1);
+        }
+    }
+
+    ~PuenteVisualV2() {
+        monitor_destruir(&monitor);
+    }
+
+    void entrar(int, int dir) override {
+        monitor_llega_cola(&monitor, (Direccion)dir);
+        monitor_pasa_coche(&monitor, (Direccion)dir);
+    }
+
+    void salir(int, int dir) override { monitor_sale_coche(&monitor, (Direccion)dir); }
+};
+
+}
+
+unique_ptr<PuenteBench> crear_puente_visualV2() {
+    return make_unique<PuenteVisualV2>();
+}
@@ -0,0 +1,404 @@
+/*
+ * BENCHMARK DE ADMISION AL PUENTE
+ * Mide entrar/salir del puente con los monitores reales de cada version del
+ * simulador, compartidos con el programa a traves de su cabecera:
+ *   duero            MonitorPuente de monitor_puente.h (CAS sobre la palabra
+ *                    de estado; los que no pasan aparcan con mutex +
+ *                    condition_variable)
+ *   visualV2         monitor_llega_cola/monitor_pasa_coche/monitor_sale_coche
+ *                    de monitor_visual.h (pthread_mutex_t + pthread_cond_t,
+ *                    con su instantanea del estado)
+ *   V4               entrar_puente/salir_puente de monitor_compartido.h
+ *                    (cerrojo y colas futex en memoria compartida), aqui
+ *                    entre hilos
+ * Se mide solo el monitor: sin el log, el estado visual de los coches ni el
+ * renderizado de cada programa.
+ *
+ * puente_visual no aparece: escribe con printf y fflush en cada transicion
+ * con el mutex del monitor tomado, asi que se mediria la terminal, y sus
+ * reglas y primitivas son las de visualV2.
+ *
+ * Como referencia mide tambien modelos reducidos de cada primitiva. No son el
+ * codigo de ningun simulador y no sirven para compararlos entre si:
+ *   modelo-mutex     std::mutex + condition_variable; cada salida despierta
+ *                    las dos colas
+ *   modelo-pthread   lo mismo con pthread_mutex_t + pthread_cond_t
+ *   modelo-semaforo  semaforo System V de capacidad, sin sentido ni turnos
+ *   modelo-atomico   CAS sobre la palabra de estado; los que no pasan giran
+ *                    con sched_yield en lugar de aparcar
+ *
+ * Cada hilo repite entrar/salir con tiempo de cruce cero; el sentido de cada
+ * paso se sortea segun el porcentaje pedido. Se informa de admisiones por
+ * segundo y de la latencia de admision (p50, p99, p99.9).
+ *
+ * Compilar: g++ -std=c++20 -O2 -pthread -Iinclude src/bench-admision*.cpp -o bench-admision
+ * Ejecutar: ./bench-admision [hilos=4] [% izquierda=50] [segundos=2]
+ *                            [estrategia=todas|reales|modelos|NOMBRE]
+ */
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <random>
+#include <string>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <algorithm>
+#include <memory>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/ipc.h>
+#include <sys/sem.h>
+
+#include "reloj.h"
+#include "histograma.h"
+#include "bench_admision.h"
+
+using namespace std;
+
+// Mismas reglas que los simuladores.
+#define MAX_COCHES_SIMULTANEOS 3
+#define MAX_COCHES_SEGUIDOS 5
+
+enum Direccion { IZQUIERDA = 0, DERECHA = 1, NINGUNO = 2 };
+
+// Modelos reducidos (ver la cabecera): mismas reglas de paso sobre una sola
+// primitiva, sin el resto de cada monitor.
+struct EstadoMonitor {
+    int en_puente[2] = {0, 0};
+    int seguidos[2] = {0, 0};
+    int esperando[2] = {0, 0};
+    Direccion turno = NINGUNO;
+
+    bool puede_pasar(Direccion mi_dir) const {
+        Direccion otra_dir = (mi_dir == IZQUIERDA) ? DERECHA : IZQUIERDA;
+        bool es_mi_turno = (turno == mi_dir || turno == NINGUNO);
+        bool puente_libre = (en_puente[otra_dir] == 0);
+        bool hay_capacidad = (en_puente[mi_dir] < MAX_COCHES_SIMULTANEOS);
+        bool puede_pasar_seguido = (esperando[otra_dir] == 0 || seguidos[mi_dir] < MAX_COCHES_SEGUIDOS);
+        return es_mi_turno && puente_libre && hay_capacidad && puede_pasar_seguido;
+    }
+
+    void admitir(Direccion mi_dir) {
+        Direccion otra_dir = (mi_dir == IZQUIERDA) ? DERECHA : IZQUIERDA;
+        esperando[mi_dir]--;
+        if (turno == NINGUNO) turno = mi_dir;
+        en_puente[mi_dir]++;
+        if (esperando[otra_dir] > 0) seguidos[mi_dir]++;
+    }
+
+    void liberar(Direccion mi_dir) {
+        Direccion otra_dir = (mi_dir == IZQUIERDA) ? DERECHA : IZQUIERDA;
+        en_puente[mi_dir]--;
+        if (en_puente[mi_dir] == 0) {
+            if (seguidos[mi_dir] >= MAX_COCHES_SEGUIDOS) seguidos[mi_dir] = 0;
+            if (esperando[otra_dir] > 0) {
+                turno = otra_dir;
+            } else {
+                turno = NINGUNO;
+                seguidos[mi_dir] = 0;
+            }
+        }
+    }
+};
+
+class PuenteMutex {
+    mutex mtx;
+    condition_variable cola[2];
+    EstadoMonitor e;
+public:
+    void entrar(int, Direccion dir) {
+        unique_lock<mutex> lock(mtx);
+        e.esperando[dir]++;
+        cola[dir].wait(lock, [&] { return e.puede_pasar(dir); });
+        e.admitir(dir);
+    }
+
+    void salir(int, Direccion dir) {
+        lock_guard<mutex> lock(mtx);
+        e.liberar(dir);
+        cola[IZQUIERDA].notify_all();
+        cola[DERECHA].notify_all();
+    }
+};
+
+class PuentePthread {
+    pthread_mutex_t mtx;
+    pthread_cond_t cola[2];
+    EstadoMonitor e;
+public:
+    PuentePthread() {
+        pthread_mutex_init(&mtx, NULL);
+        pthread_cond_init(&cola[0], NULL);
+        pthread_cond_init(&cola[1], NULL);
+    }
+
+    ~PuentePthread() {
+        pthread_mutex_destroy(&mtx);
+        pthread_cond_destroy(&cola[0]);
+        pthread_cond_destroy(&cola[1]);
+    }
+
+    void entrar(int, Direccion dir) {
+        pthread_mutex_lock(&mtx);
+        e.esperando[dir]++;
+        while (!e.puede_pasar(dir)) {
+            pthread_cond_wait(&cola[dir], &mtx);
+        }
+        e.admitir(dir);
+        pthread_mutex_unlock(&mtx);
+    }
+
+    void salir(int, Direccion dir) {
+        pthread_mutex_lock(&mtx);
+        e.liberar(dir);
+        pthread_cond_broadcast(&cola[IZQUIERDA]);
+        pthread_cond_broadcast(&cola[DERECHA]);
+        pthread_mutex_unlock(&mtx);
+    }
+};
+
+union semun {
+    int val;
+    struct semid_ds *buf;
+    unsigned short *array;
+};
+
+class PuenteSemaforo {
+    int semid;
+
+    void operacion(int op) {
+        struct sembuf sbuf;
+        sbuf.sem_num = 0;
+        sbuf.sem_op = op;
+        sbuf.sem_flg = 0;
+        while (semop(semid, &sbuf, 1) == -1) {
+            if (errno != EINTR) {
+                perror("Error en semop");
+                exit(1);
+            }
+        }
+    }
+public:
+    PuenteSemaforo() {
+        semid = semget(IPC_PRIVATE, 1, IPC_CREAT | 0600);
+        if (semid == -1) {
+            perror("Error al crear semáforo");
+            exit(1);
+        }
+        union semun arg;
+        arg.val = MAX_COCHES_SIMULTANEOS;
+        semctl(semid, 0, SETVAL, arg);
+    }
+
+    ~PuenteSemaforo() {
+        semctl(semid, 0, IPC_RMID);
+    }
+
+    void entrar(int, Direccion) { operacion(-1); }
+    void salir(int, Direccion) { operacion(1); }
+};
+
+// Mismo empaquetado que EstadoPuente en sim-puente-duero, reducido a bytes:
+// en_puente[2], seguidos[2], turno, esperando[2] (hasta MAX_HILOS).
+class PuenteAtomico {
+    atomic<uint64_t> palabra{0};
+
+    static EstadoMonitor decodificar(uint64_t p) {
+        EstadoMonitor e;
+        for (int d = 0; d < 2; d++) {
+            e.en_puente[d] = (p >> (8 * d)) & 0xFF;
+            e.seguidos[d] = (p >> (16 + 8 * d)) & 0xFF;
+            e.esperando[d] = (p >> (40 + 8 * d)) & 0xFF;
+        }
+        e.turno = (Direccion)((p >> 32) & 0xFF);
+        return e;
+    }
+
+    static uint64_t codificar(const EstadoMonitor& e) {
+        uint64_t p = 0;
+        for (int d = 0; d < 2; d++) {
+            p |= (uint64_t)e.en_puente[d] << (8 * d);
+            p |= (uint64_t)e.seguidos[d] << (16 + 8 * d);
+            p |= (uint64_t)e.esperando[d] << (40 + 8 * d);
+        }
+        p |= (uint64_t)e.turno << 32;
+        return p;
+    }
+public:
+    PuenteAtomico() {
+        palabra = codificar(EstadoMonitor());
+    }
+
+    void entrar(int, Direccion dir) {
+        uint64_t actual = palabra.fetch_add(1ULL << (40 + 8 * dir)) + (1ULL << (40 + 8 * dir));
+        int intentos = 0;
+        while (true) {
+            EstadoMonitor e = decodificar(actual);
+            if (e.puede_pasar(dir)) {
+                e.admitir(dir);
+                if (palabra.compare_exchange_weak(actual, codificar(e))) {
+                    return;
+                }
+                continue;
+            }
+            if (++intentos > 64) {
+                sched_yield();
+            }
+            actual = palabra.load();
+        }
+    }
+
+    void salir(int, Direccion dir) {
+        uint64_t actual = palabra.load();
+        while (true) {
+            EstadoMonitor e = decodificar(actual);
+            e.liberar(dir);
+            if (palabra.compare_exchange_weak(actual, codificar(e))) {
+                return;
+            }
+        }
+    }
+};
+
+// Los modelos se miden a traves de la misma interfaz que los monitores reales.
+template <class Modelo>
+class PuenteModelo : public PuenteBench {
+    Modelo modelo;
+public:
+    void entrar(int hilo, int dir) override { modelo.entrar(hilo, (Direccion)dir); }
+    void salir(int hilo, int dir) override { modelo.salir(hilo, (Direccion)dir); }
+};
+
+template <class Modelo>
+unique_ptr<PuenteBench> crear_modelo() {
+    return make_unique<PuenteModelo<Modelo>>();
+}
+
+struct ConfiguracionBench {
+    int hilos = 4;
+    int porcentaje_izquierda = 50;
+    double segundos = 2.0;
+};
+
+struct alignas(64) ResultadoHilo {
+    uint64_t admisiones = 0;
+    Histograma latencia;
+};
+
+void medir(const string& nombre, unique_ptr<PuenteBench> puente, const ConfiguracionBench& cfg) {
+    vector<ResultadoHilo> resultados(cfg.hilos);
+    atomic<int> listos{0};
+    atomic<bool> inicio{false};
+    atomic<bool> detener{false};
+    vector<thread> hilos;
+
+    for (int h = 0; h < cfg.hilos; h++) {
+        hilos.emplace_back([&, h] {
+            mt19937 gen(1000 + h);
+            uniform_int_distribution<> porcentaje(0, 99);
+            ResultadoHilo& r = resultados[h];
+
+            listos++;
+            while (!inicio.load()) {
+                this_thread::yield();
+            }
+            while (!detener.load(memory_order_relaxed)) {
+                Direccion dir = (porcentaje(gen) < cfg.porcentaje_izquierda) ? IZQUIERDA : DERECHA;
+                int64_t t0 = reloj_monotonico_ns();
+                puente->entrar(h, dir);
+                int64_t t1 = reloj_monotonico_ns();
+                puente->salir(h, dir);
+                r.latencia.registrar((uint64_t)(t1 - t0));
+                r.admisiones++;
+            }
+        });
+    }
+
+    while (listos.load() < cfg.hilos) {
+        this_thread::yield();
+    }
+    int64_t t_inicio = reloj_monotonico_ns();
+    inicio = true;
+    this_thread::sleep_for(chrono::duration<double>(cfg.segundos));
+    detener = true;
+    for (thread& t : hilos) t.join();
+    double segundos = (reloj_monotonico_ns() - t_inicio) / 1e9;
+
+    Histograma total;
+    uint64_t admisiones = 0;
+    for (const ResultadoHilo& r : resultados) {
+        total.combinar(r.latencia);
+        admisiones += r.admisiones;
+    }
+
+    cout << left << setw(17) << nombre << right
+         << setw(14) << fixed << setprecision(0) << admisiones / segundos
+         << setw(11) << total.percentil(50)
+         << setw(11) << total.percentil(99)
+         << setw(11) << total.percentil(99.9)
+         << setw(12) << total.maximo() << "\n";
+}
+
+struct Estrategia {
+    const char* nombre;
+    bool modelo;
+    unique_ptr<PuenteBench> (*crear)();
+};
+
+const Estrategia ESTRATEGIAS[] = {
+    {"duero", false, crear_puente_duero},
+    {"visualV2", false, crear_puente_visualV2},
+    {"V4", false, crear_puente_V4},
+    {"modelo-mutex", true, crear_modelo<PuenteMutex>},
+    {"modelo-pthread", true, crear_modelo<PuentePthread>},
+    {"modelo-semaforo", true, crear_modelo<PuenteSemaforo>},
+    {"modelo-atomico", true, crear_modelo<PuenteAtomico>},
+};
+
+bool elegida(const Estrategia& e, const string& estrategia) {
+    return estrategia == "todas" || estrategia == e.nombre ||
+           (estrategia == "reales" && !e.modelo) || (estrategia == "modelos" && e.modelo);
+}
+
+int main(int argc, char* argv[]) {
+    ConfiguracionBench cfg;
+    if (argc > 1) cfg.hilos = min(MAX_HILOS, max(1, atoi(argv[1])));
+    if (argc > 2) cfg.porcentaje_izquierda = min(100, max(0, atoi(argv[2])));
+    if (argc > 3) cfg.segundos = max(0.1, atof(argv[3]));
+    string estrategia = (argc > 4) ? argv[4] : "todas";
+
+    bool alguna = false;
+    bool modelos = false;
+    for (const Estrategia& e : ESTRATEGIAS) {
+        if (elegida(e, estrategia)) {
+            alguna = true;
+            modelos = modelos || e.modelo;
+        }
+    }
+    if (!alguna) {
+        cerr << "Estrategia desconocida: " << estrategia << " (todas, reales, modelos";
+        for (const Estrategia& e : ESTRATEGIAS) cerr << ", " << e.nombre;
+        cerr << ")" << endl;
+        return 1;
+    }
+
+    cout << "\nBenchmark de admisión: " << cfg.hilos << " hilos, " << cfg.porcentaje_izquierda
+         << "% hacia la IZQUIERDA, " << cfg.segundos << " s por estrategia\n\n";
+    cout << left << setw(17) << "Estrategia" << right << setw(14) << "Admisiones/s"
+         << setw(11) << "p50 (ns)" << setw(11) << "p99 (ns)" << setw(11) << "p99.9 (ns)" << setw(13) << "máx (ns)" << "\n";
+
+    for (const Estrategia& e : ESTRATEGIAS) {
+        if (elegida(e, estrategia)) medir(e.nombre, e.crear(), cfg);
+    }
+    if (modelos) {
+        cout << "\nLas filas modelo-* miden una primitiva aislada, no el monitor de ningún simulador.\n";
+    }
+    cout << "\n";
+    return 0;
+}
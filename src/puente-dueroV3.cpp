@@ -14,6 +14,8 @@
 #include <cstdlib>
 #include <algorithm> 
 
+#include "reloj.h"
+
 using namespace std;
 
 // ============================================================================
@@ -49,19 +51,6 @@ struct Coche {
 // ============================================================================
 // DECLARACIÓN ANTICIPADA Y AUXILIARES
 // ============================================================================
-string get_timestamp() {
-    auto now = chrono::system_clock::to_time_t(chrono::system_clock::now());
-    tm tm_info;
-    #ifdef _WIN32
-        localtime_s(&tm_info, &now);
-    #else
-        localtime_r(&now, &tm_info);
-    #endif
-    stringstream ss;
-    ss << put_time(&tm_info, "%H:%M:%S");
-    return ss.str();
-}
-
 string direccion_str(Direccion dir) {
     switch(dir) {
         case IZQUIERDA: return "IZQUIERDA";
@@ -102,7 +91,7 @@ public:
     MonitorPuente() {
         sistema_activo = true;
         sistema_en_pausa = false;
-        cerr << "[" << get_timestamp() << "] ✓ Monitor del puente inicializado correctamente" << endl;
+        cerr << "[" << hora_actual() << "] ✓ Monitor del puente inicializado correctamente" << endl;
     }
 
     void set_sensor_ok(Direccion dir, bool estado) {
@@ -180,7 +169,7 @@ void log_evento(const string& mensaje) {
     if (monitor.sistema_en_pausa) {
         return; 
     }
-    cerr << "[" << get_timestamp() << "] " << mensaje << endl;
+    cerr << "[" << hora_actual() << "] " << mensaje << endl;
 }
 
 // Implementación de las funciones de MonitorPuente 
@@ -492,7 +481,7 @@ void tarea_intervencion() {
             this_thread::sleep_for(chrono::milliseconds(100)); 
         }
     }
-    cerr << "[" << get_timestamp() << "] 🛑 Hilo de Intervención finalizado." << endl;
+    cerr << "[" << hora_actual() << "] 🛑 Hilo de Intervención finalizado." << endl;
 }
 
 
@@ -525,12 +514,12 @@ int main() {
     
     // CORRECCIÓN V13: Esperar activamente si el sistema sigue en pausa.
     if (monitor.sistema_en_pausa) {
-        cerr << "[" << get_timestamp() << "] ⏳ Generadores terminados, esperando intervención para apagar..." << endl;
+        cerr << "[" << hora_actual() << "] ⏳ Generadores terminados, esperando intervención para apagar..." << endl;
         // Esperamos en un bucle simple hasta que el operario reanude el sistema.
         while (monitor.sistema_en_pausa) {
             this_thread::sleep_for(chrono::milliseconds(200));
         }
-        cerr << "[" << get_timestamp() << "] ✓ Intervención completada. Procediendo al apagado final." << endl;
+        cerr << "[" << hora_actual() << "] ✓ Intervención completada. Procediendo al apagado final." << endl;
     }
     
     // Una vez que los generadores han terminado y NO hay intervención pendiente, cerramos el sistema.
@@ -559,7 +548,7 @@ int main() {
     cout << "╚═══════════════════════════════════════════════════════════════╝\n";
     cout << "\n";
     
-    cerr << "[" << get_timestamp() << "] ✓ Sistema finalizado correctamente" << endl;
+    cerr << "[" << hora_actual() << "] ✓ Sistema finalizado correctamente" << endl;
     
     return 0;
 }
\ No newline at end of file
@@ -10,6 +10,14 @@
  *   i - Añadir coche IZQUIERDA
  *   d - Añadir coche DERECHA
  *   ESPACIO - Pausar/Reanudar
+ *   Flechas / RePág / AvPág - Recorrer el historial del log (Fin vuelve al final)
+ *
+ * Modo sin interfaz (sin ncurses ni terminal, para pruebas largas):
+ *   ./puente_tui --sin-interfaz [--formato json|csv] [--fd N] [--intervalo MS]
+ *                [--duracion S] [--periodo MS] [--probabilidad P] [--cruce MS]
+ *                [--semilla N]
+ *   Escribe una línea de métricas cada intervalo en el descriptor N (1 por
+ *   defecto) hasta que pasa la duración o llega SIGINT/SIGTERM.
  */
 
 // ============================================================================
@@ -27,23 +35,29 @@
 #include <sys/ipc.h>        // Para IPC (Inter-Process Communication)
 #include <sys/sem.h>        // Para semáforos System V
 #include <sys/stat.h>       // Para estadísticas de archivos
+#include <sys/mman.h>       // Para proyectar el historial del log
+#include <signal.h>         // Para terminar el modo sin interfaz
 #include <string.h>         // Para manipulación de strings
 #include <time.h>           // Para timestamps
 #include <stdbool.h>        // Para tipo bool
 #include <stdarg.h>         // Para funciones con argumentos variables
+#include <stdint.h>         // Para enteros de tamaño fijo
 #include <ncurses.h>        // Para interfaz TUI
+#include <sched.h>          // Para sched_yield
+
+#include "reloj.h"          // Para timestamps sin localtime por linea
+#include "monitor_visual.h" // Monitor del puente y su instantánea
 
 // ============================================================================
 // CONSTANTES DEL SISTEMA
 // ============================================================================
-#define MAX_COCHES_SIMULTANEOS 3
-#define MAX_COCHES_SEGUIDOS 5
 #define TIEMPO_CRUCE_MS 2000
+#define PERIODO_GENERADOR_MS 2000
+#define PROBABILIDAD_GENERADOR 30
 #define MAX_LOG_LINES 15
 #define ANCHO_PUENTE 60
 
-// Direcciones
-typedef enum { IZQUIERDA = 0, DERECHA = 1, NINGUNO = 2 } Direccion;
+// Estados del coche
 typedef enum { ESPERANDO, CRUZANDO, FINALIZADO } EstadoCoche;
 
 // Colores
@@ -63,34 +77,15 @@ enum {
     COLOR_PAIR_TURNO_DER
 };
 
-// ============================================================================
-// ESTRUCTURA DEL MONITOR DEL PUENTE
-// ============================================================================
-typedef struct {
-    // Mutex principal del monitor (exclusión mutua)
-    pthread_mutex_t mutex;
-    
-    // Variables condicionales (entradas del monitor)
-    pthread_cond_t cola_izquierda;
-    pthread_cond_t cola_derecha;
-    
-    // Estado del puente
-    int coches_en_puente[2];      // Coches actualmente cruzando por lado
-    int coches_esperando[2];      // Coches esperando por lado (sensores)
-    int coches_seguidos[2];       // Contador de coches consecutivos
-    Direccion turno;              // Turno actual (IZQUIERDA, DERECHA, NINGUNO)
-    
-    // Estadísticas
-    int total_cruzados;
-    int total_generados;
-    
-    // Control de ejecución
-    bool sistema_activo;
-    bool pausado;
-    
-} MonitorPuente;
+// Parámetros de la carga (ajustables en el modo sin interfaz)
+int tiempo_cruce_ms = TIEMPO_CRUCE_MS;
+int periodo_generador_ms = PERIODO_GENERADOR_MS;
+int probabilidad_generador = PROBABILIDAD_GENERADOR;
+
+// Sin interfaz nadie recorre el historial: el log se vacía sin guardarlo
+bool historial_activo = true;
 
-// Variable global del monitor
+// Variable global del monitor (ver monitor_visual.h)
 MonitorPuente monitor;
 
 // ============================================================================
@@ -100,45 +95,400 @@ typedef struct {
     int id;
     Direccion direccion;
     EstadoCoche estado;
-    float posicion;  // Para animación (0.0 a 1.0)
     time_t tiempo_llegada;
-    time_t tiempo_inicio_cruce;
+    int64_t tiempo_inicio_cruce;  // ms del reloj monotono; la posición se calcula al dibujar
     time_t tiempo_salida;
 } Coche;
 
-// Array global para visualización
-#define MAX_COCHES_VISUALES 50
-Coche coches_visuales[MAX_COCHES_VISUALES];
-int num_coches_visuales = 0;
+// ============================================================================
+// REGISTRO DE COCHES (SLOT MAP)
+// ============================================================================
+// Los coches viven en bloques de ranuras que no se mueven nunca: el puntero
+// que recibe tarea_coche sigue siendo válido aunque se inserten o eliminen
+// otros coches. Las ranuras libres forman una lista enlazada por índice y
+// los índices de las ocupadas se guardan en un array denso para recorrerlas
+// sin visitar huecos. Insertar y eliminar son O(1).
+//
+// Un manejador combina índice y generación. Al liberar una ranura su
+// generación avanza, así que un manejador antiguo deja de resolver en lugar
+// de apuntar al coche que reutiliza la ranura.
+//
+// Todas las funciones registro_* se llaman con mutex_visuales tomado.
+typedef uint64_t ManejadorCoche;
+
+#define COCHE_NULO 0
+#define RANURAS_POR_BLOQUE 256
+#define MAX_BLOQUES 1024               // hasta 262144 coches vivos
+#define SIN_RANURA UINT32_MAX
+
+typedef struct {
+    Coche coche;
+    uint32_t generacion;        // empieza en 1: ningún manejador válido vale 0
+    uint32_t siguiente_libre;   // si la ranura está libre
+    uint32_t posicion_densa;    // si está ocupada, índice en densos
+    bool ocupada;
+} RanuraCoche;
+
+typedef struct {
+    RanuraCoche* bloques[MAX_BLOQUES];
+    uint32_t num_bloques;
+    uint32_t libre;             // cabeza de la lista de libres
+    uint32_t* densos;           // índices de las ranuras ocupadas
+    uint32_t num_vivos;
+} RegistroCoches;
+
+RegistroCoches registro;
 pthread_mutex_t mutex_visuales;
 
-// Log de eventos
-char log_buffer[MAX_LOG_LINES][100];
-int log_index = 0;
-pthread_mutex_t mutex_log;
+static inline RanuraCoche* registro_ranura(RegistroCoches* r, uint32_t indice) {
+    return &r->bloques[indice / RANURAS_POR_BLOQUE][indice % RANURAS_POR_BLOQUE];
+}
+
+static inline ManejadorCoche registro_manejador(uint32_t indice, uint32_t generacion) {
+    return ((ManejadorCoche)generacion << 32) | indice;
+}
+
+bool registro_crecer(RegistroCoches* r) {
+    if (r->num_bloques == MAX_BLOQUES) {
+        return false;
+    }
+    RanuraCoche* bloque = (RanuraCoche*)calloc(RANURAS_POR_BLOQUE, sizeof(RanuraCoche));
+    uint32_t* densos = (uint32_t*)realloc(r->densos, (size_t)(r->num_bloques + 1) * RANURAS_POR_BLOQUE * sizeof(uint32_t));
+    if (bloque == NULL || densos == NULL) {
+        free(bloque);
+        if (densos != NULL) r->densos = densos;
+        return false;
+    }
+    r->densos = densos;
+    
+    // Encadenar las ranuras nuevas delante de la lista de libres
+    uint32_t base = r->num_bloques * RANURAS_POR_BLOQUE;
+    for (uint32_t i = 0; i < RANURAS_POR_BLOQUE; i++) {
+        bloque[i].generacion = 1;
+        bloque[i].siguiente_libre = (i + 1 < RANURAS_POR_BLOQUE) ? base + i + 1 : r->libre;
+    }
+    r->bloques[r->num_bloques++] = bloque;
+    r->libre = base;
+    return true;
+}
+
+// Devuelve COCHE_NULO si no se pudo reservar memoria.
+ManejadorCoche registro_insertar(RegistroCoches* r, Coche** coche) {
+    if (r->libre == SIN_RANURA && !registro_crecer(r)) {
+        return COCHE_NULO;
+    }
+    uint32_t indice = r->libre;
+    RanuraCoche* ranura = registro_ranura(r, indice);
+    r->libre = ranura->siguiente_libre;
+    
+    ranura->ocupada = true;
+    ranura->posicion_densa = r->num_vivos;
+    r->densos[r->num_vivos++] = indice;
+    memset(&ranura->coche, 0, sizeof(Coche));
+    *coche = &ranura->coche;
+    return registro_manejador(indice, ranura->generacion);
+}
+
+Coche* registro_obtener(RegistroCoches* r, ManejadorCoche manejador) {
+    uint32_t indice = (uint32_t)manejador;
+    if (indice >= r->num_bloques * RANURAS_POR_BLOQUE) {
+        return NULL;
+    }
+    RanuraCoche* ranura = registro_ranura(r, indice);
+    if (!ranura->ocupada || ranura->generacion != (uint32_t)(manejador >> 32)) {
+        return NULL;
+    }
+    return &ranura->coche;
+}
+
+bool registro_eliminar(RegistroCoches* r, ManejadorCoche manejador) {
+    if (registro_obtener(r, manejador) == NULL) {
+        return false;
+    }
+    uint32_t indice = (uint32_t)manejador;
+    RanuraCoche* ranura = registro_ranura(r, indice);
+    
+    // Solo se mueve el índice del último ocupado, nunca un coche
+    uint32_t ultimo = r->densos[--r->num_vivos];
+    r->densos[ranura->posicion_densa] = ultimo;
+    registro_ranura(r, ultimo)->posicion_densa = ranura->posicion_densa;
+    
+    ranura->ocupada = false;
+    ranura->generacion++;
+    if (ranura->generacion == 0) ranura->generacion = 1;
+    ranura->siguiente_libre = r->libre;
+    r->libre = indice;
+    return true;
+}
+
+void registro_inicializar(RegistroCoches* r) {
+    memset(r, 0, sizeof(*r));
+    r->libre = SIN_RANURA;
+}
+
+void registro_destruir(RegistroCoches* r) {
+    for (uint32_t b = 0; b < r->num_bloques; b++) {
+        free(r->bloques[b]);
+    }
+    free(r->densos);
+    registro_inicializar(r);
+}
+
+// ============================================================================
+// LOG DE EVENTOS
+// ============================================================================
+// Los hilos no formatean nada: publican un registro binario de tamaño fijo
+// en un anillo sin cerrojos (cola acotada de Vyukov, varios productores y un
+// consumidor). El hilo de renderizado vacía el anillo en el historial y
+// formatea solo las líneas que se ven. El historial es un fichero temporal
+// proyectado con mmap que crece con la sesión, así que se puede recorrer
+// entero con las flechas. Si el anillo se llena entre dos cuadros el
+// registro se descarta y se cuenta en log_perdidos.
+typedef enum { LOG_TEXTO, LOG_COLA, LOG_ENTRA, LOG_SALE } TipoLog;
+
+#define TEXTO_LOG 48
+
+typedef struct {
+    int64_t tiempo_ms;          // reloj de pared
+    int32_t coche;
+    uint16_t tipo;              // TipoLog
+    uint16_t direccion;
+    char texto[TEXTO_LOG];      // solo LOG_TEXTO
+} RegistroLog;
+
+typedef struct {
+    unsigned secuencia;         // posición + 1 cuando el registro está escrito
+    RegistroLog registro;
+} RanuraLog;
+
+#define CAPACIDAD_LOG 4096      // potencia de 2
+#define REGISTROS_HISTORIAL_INICIAL 16384
+
+RanuraLog anillo_log[CAPACIDAD_LOG];
+unsigned cabeza_log = 0;        // siguiente posición a reservar (productores)
+unsigned cola_log = 0;          // siguiente posición a leer (renderizado)
+unsigned long log_perdidos = 0;
+
+// Solo lo usa el hilo de renderizado
+typedef struct {
+    RegistroLog* registros;
+    size_t num;
+    size_t capacidad;
+    int fd;                     // -1: historial en memoria
+} HistorialLog;
+
+HistorialLog historial;
+size_t historial_publicado = 0; // num del historial, para el hilo de entrada
+int desplazamiento_log = 0;     // líneas por encima del final que se muestran
+
+// ============================================================================
+// CONTROL DE CAMBIOS PARA EL RENDERIZADO
+// ============================================================================
+// Cada panel depende de una o varias versiones. Quien modifica un dato
+// incrementa su version; el hilo de renderizado solo redibuja los paneles
+// cuyas versiones han cambiado desde el ultimo cuadro y, si no cambia nada,
+// duerme en cond_render en lugar de repintar la pantalla.
+unsigned version_monitor = 0;      // estado del puente y estadisticas
+unsigned version_visuales = 0;     // lista de coches y sus estados
+unsigned version_log = 0;          // buffer de log
+int render_durmiendo = 0;
+pthread_mutex_t mutex_render = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t cond_render = PTHREAD_COND_INITIALIZER;
+
+#define INTERVALO_CUADRO_MS 50     // como mucho 20 cuadros por segundo
+#define MAX_COCHES_DIBUJADOS 32    // coches sobre el puente en un cuadro
+#define ESPERA_INACTIVO_MS 500     // para detectar cambios de tamaño y el fin
+
+void despertar_render() {
+    pthread_mutex_lock(&mutex_render);
+    pthread_cond_signal(&cond_render);
+    pthread_mutex_unlock(&mutex_render);
+}
+
+// El incremento y la lectura de render_durmiendo son secuencialmente
+// consistentes, igual que la comprobacion del renderizado antes de dormir:
+// o el productor ve que duerme y le avisa, o el renderizado ve la version
+// nueva y no se duerme. Mientras el renderizado trabaja no se toca el mutex.
+void marcar_cambio(unsigned* version) {
+    __atomic_fetch_add(version, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&render_durmiendo, __ATOMIC_SEQ_CST)) {
+        despertar_render();
+    }
+}
+
+unsigned leer_version(unsigned* version) {
+    return __atomic_load_n(version, __ATOMIC_SEQ_CST);
+}
 
 // ============================================================================
 // FUNCIONES DE LOG Y UTILIDADES
 // ============================================================================
 
-void agregar_log(const char* formato, ...) {
-    pthread_mutex_lock(&mutex_log);
-    
-    time_t now = time(NULL);
-    struct tm* tm_info = localtime(&now);
-    char timestamp[20];
-    strftime(timestamp, sizeof(timestamp), "%H:%M:%S", tm_info);
-    
-    char mensaje[80];
-    va_list args;
-    va_start(args, formato);
-    vsnprintf(mensaje, sizeof(mensaje), formato, args);
-    va_end(args);
-    
-    snprintf(log_buffer[log_index], 100, "[%s] %s", timestamp, mensaje);
-    log_index = (log_index + 1) % MAX_LOG_LINES;
+void publicar_log(const RegistroLog* registro) {
+    unsigned posicion = __atomic_load_n(&cabeza_log, __ATOMIC_RELAXED);
+    RanuraLog* ranura;
+    while (true) {
+        ranura = &anillo_log[posicion & (CAPACIDAD_LOG - 1)];
+        unsigned secuencia = __atomic_load_n(&ranura->secuencia, __ATOMIC_ACQUIRE);
+        int diferencia = (int)(secuencia - posicion);
+        if (diferencia == 0) {
+            if (__atomic_compare_exchange_n(&cabeza_log, &posicion, posicion + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diferencia < 0) {
+            // Anillo lleno: el renderizado no ha vaciado todavía esta vuelta
+            __atomic_fetch_add(&log_perdidos, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            posicion = __atomic_load_n(&cabeza_log, __ATOMIC_RELAXED);
+        }
+    }
+    ranura->registro = *registro;
+    __atomic_store_n(&ranura->secuencia, posicion + 1, __ATOMIC_RELEASE);
     
-    pthread_mutex_unlock(&mutex_log);
+    marcar_cambio(&version_log);
+}
+
+void agregar_log(const char* texto) {
+    RegistroLog registro;
+    memset(&registro, 0, sizeof(registro));
+    registro.tiempo_ms = reloj_ms();
+    registro.tipo = LOG_TEXTO;
+    // Se recorta sin partir un carácter UTF-8: ncurses no debe recibir
+    // una secuencia incompleta.
+    size_t largo = strlen(texto);
+    size_t n = largo < TEXTO_LOG - 1 ? largo : TEXTO_LOG - 1;
+    while (n > 0 && n < largo && ((unsigned char)texto[n] & 0xC0) == 0x80) {
+        n--;
+    }
+    memcpy(registro.texto, texto, n);
+    publicar_log(&registro);
+}
+
+void log_coche(TipoLog tipo, int coche, Direccion direccion) {
+    RegistroLog registro;
+    registro.tiempo_ms = reloj_ms();
+    registro.coche = coche;
+    registro.tipo = tipo;
+    registro.direccion = direccion;
+    registro.texto[0] = '\0';
+    publicar_log(&registro);
+}
+
+void inicializar_log() {
+    for (unsigned i = 0; i < CAPACIDAD_LOG; i++) {
+        anillo_log[i].secuencia = i;
+    }
+    cabeza_log = 0;
+    cola_log = 0;
+    
+    // El fichero se borra al crearlo: solo vive mientras dura la sesión
+    historial.registros = NULL;
+    historial.num = 0;
+    historial.capacidad = 0;
+    char ruta[] = "/tmp/puente-duero-log-XXXXXX";
+    historial.fd = mkstemp(ruta);
+    if (historial.fd != -1) {
+        unlink(ruta);
+    }
+}
+
+bool crecer_historial() {
+    size_t capacidad = historial.capacidad ? historial.capacidad * 2 : REGISTROS_HISTORIAL_INICIAL;
+    size_t bytes = capacidad * sizeof(RegistroLog);
+    RegistroLog* registros;
+    
+    if (historial.fd != -1) {
+        if (ftruncate(historial.fd, (off_t)bytes) == 0) {
+            void* mapa = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, historial.fd, 0);
+            if (mapa != MAP_FAILED) {
+                if (historial.registros != NULL) {
+                    munmap(historial.registros, historial.capacidad * sizeof(RegistroLog));
+                }
+                historial.registros = (RegistroLog*)mapa;
+                historial.capacidad = capacidad;
+                return true;
+            }
+        }
+        // Sin fichero se sigue en memoria con lo ya guardado
+        registros = (RegistroLog*)malloc(bytes);
+        if (registros == NULL) {
+            return false;
+        }
+        if (historial.registros != NULL) {
+            memcpy(registros, historial.registros, historial.num * sizeof(RegistroLog));
+            munmap(historial.registros, historial.capacidad * sizeof(RegistroLog));
+        }
+        close(historial.fd);
+        historial.fd = -1;
+    } else {
+        registros = (RegistroLog*)realloc(historial.registros, bytes);
+        if (registros == NULL) {
+            return false;
+        }
+    }
+    historial.registros = registros;
+    historial.capacidad = capacidad;
+    return true;
+}
+
+// Pasa al historial todo lo publicado. Devuelve cuántos registros movió.
+size_t vaciar_log() {
+    size_t movidos = 0;
+    while (true) {
+        RanuraLog* ranura = &anillo_log[cola_log & (CAPACIDAD_LOG - 1)];
+        if (__atomic_load_n(&ranura->secuencia, __ATOMIC_ACQUIRE) != cola_log + 1) {
+            break;
+        }
+        if (!historial_activo) {
+            movidos++;
+        } else if (historial.num < historial.capacidad || crecer_historial()) {
+            historial.registros[historial.num++] = ranura->registro;
+            movidos++;
+        } else {
+            __atomic_fetch_add(&log_perdidos, 1, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&ranura->secuencia, cola_log + CAPACIDAD_LOG, __ATOMIC_RELEASE);
+        cola_log++;
+    }
+    if (movidos > 0 && historial_activo) {
+        __atomic_store_n(&historial_publicado, historial.num, __ATOMIC_RELAXED);
+        // Si se está viendo el historial, la vista no se mueve. CAS porque
+        // el hilo de entrada también lo cambia (desplazar_log y Fin).
+        int actual = __atomic_load_n(&desplazamiento_log, __ATOMIC_RELAXED);
+        while (actual > 0 &&
+               !__atomic_compare_exchange_n(&desplazamiento_log, &actual, actual + (int)movidos, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        }
+    }
+    return movidos;
+}
+
+void destruir_log() {
+    if (historial.fd != -1) {
+        if (historial.registros != NULL) {
+            munmap(historial.registros, historial.capacidad * sizeof(RegistroLog));
+        }
+        close(historial.fd);
+    } else {
+        free(historial.registros);
+    }
+    historial.registros = NULL;
+    historial.num = historial.capacidad = 0;
+}
+
+void desplazar_log(int lineas) {
+    int actual = __atomic_load_n(&desplazamiento_log, __ATOMIC_RELAXED);
+    int nuevo;
+    do {
+        int maximo = (int)__atomic_load_n(&historial_publicado, __ATOMIC_RELAXED) - MAX_LOG_LINES;
+        nuevo = actual + lineas;
+        if (nuevo > maximo) nuevo = maximo;
+        if (nuevo < 0) nuevo = 0;
+    } while (!__atomic_compare_exchange_n(&desplazamiento_log, &actual, nuevo, true,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    marcar_cambio(&version_log);
 }
 
 const char* direccion_str(Direccion dir) {
@@ -195,6 +545,18 @@ void dibujar_caja(int y, int x, int alto, int ancho, const char* titulo) {
     }
 }
 
+// Borra un rectangulo sin tocar el resto de la pantalla (clear() obligaria
+// a ncurses a reenviar la pantalla completa).
+void limpiar_region(int y, int x, int alto, int ancho) {
+    int max_y, max_x;
+    getmaxyx(stdscr, max_y, max_x);
+    if (x < 0) { ancho += x; x = 0; }
+    if (x + ancho > max_x) ancho = max_x - x;
+    for (int i = 0; i < alto && y + i < max_y; i++) {
+        if (y + i >= 0 && ancho > 0) mvhline(y + i, x, ' ', ancho);
+    }
+}
+
 void dibujar_barra_progreso(int y, int x, int ancho, float porcentaje, int color_pair) {
     int lleno = (int)(ancho * porcentaje);
     
@@ -221,16 +583,23 @@ void dibujar_header() {
     attroff(COLOR_PAIR(COLOR_PAIR_TITULO) | A_BOLD);
 }
 
-void dibujar_puente(int start_y) {
+// Fracción del cruce recorrida (0.0 a 1.0) en el instante ahora_ms.
+float posicion_coche(const Coche* coche, int64_t ahora_ms) {
+    float posicion = (float)(ahora_ms - coche->tiempo_inicio_cruce) / tiempo_cruce_ms;
+    if (posicion < 0.0f) return 0.0f;
+    if (posicion > 1.0f) return 1.0f;
+    return posicion;
+}
+
+void dibujar_puente(int start_y, const EstadoVisible* estado, const Coche* coches, int num_coches, int64_t ahora_ms) {
     int max_y, max_x;
     getmaxyx(stdscr, max_y, max_x);
     int start_x = (max_x - ANCHO_PUENTE - 40) / 2;
     
     // Dibujar caja del puente
+    limpiar_region(start_y, start_x, 12, ANCHO_PUENTE + 40);
     dibujar_caja(start_y, start_x, 12, ANCHO_PUENTE + 40, "PUENTE");
     
-    pthread_mutex_lock(&monitor.mutex);
-    
     // Carretera izquierda
     attron(COLOR_PAIR(COLOR_PAIR_INFO));
     for (int i = 0; i < 10; i++) {
@@ -239,7 +608,7 @@ void dibujar_puente(int start_y) {
     attroff(COLOR_PAIR(COLOR_PAIR_INFO));
     
     // Barrera izquierda (SENSOR - se abre cuando hay coches cruzando)
-    bool barrera_izq_abierta = (monitor.coches_en_puente[IZQUIERDA] > 0);
+    bool barrera_izq_abierta = (estado->coches_en_puente[IZQUIERDA] > 0);
     int color_barrera_izq = barrera_izq_abierta ? COLOR_PAIR_BARRERA_ABIERTA : COLOR_PAIR_BARRERA_CERRADA;
     attron(COLOR_PAIR(color_barrera_izq) | A_BOLD);
     if (barrera_izq_abierta) {
@@ -262,7 +631,7 @@ void dibujar_puente(int start_y) {
     attroff(COLOR_PAIR(COLOR_PAIR_PUENTE) | A_BOLD);
     
     // Barrera derecha (SENSOR - se abre cuando hay coches cruzando)
-    bool barrera_der_abierta = (monitor.coches_en_puente[DERECHA] > 0);
+    bool barrera_der_abierta = (estado->coches_en_puente[DERECHA] > 0);
     int color_barrera_der = barrera_der_abierta ? COLOR_PAIR_BARRERA_ABIERTA : COLOR_PAIR_BARRERA_CERRADA;
     attron(COLOR_PAIR(color_barrera_der) | A_BOLD);
     if (barrera_der_abierta) {
@@ -282,53 +651,50 @@ void dibujar_puente(int start_y) {
     attroff(COLOR_PAIR(COLOR_PAIR_INFO));
     
     // Dibujar coches en movimiento (animación)
-    pthread_mutex_lock(&mutex_visuales);
-    for (int i = 0; i < num_coches_visuales; i++) {
-        if (coches_visuales[i].estado == CRUZANDO) {
-            int color = (coches_visuales[i].direccion == IZQUIERDA) ? 
+    for (int i = 0; i < num_coches; i++) {
+        if (coches[i].estado == CRUZANDO) {
+            int color = (coches[i].direccion == IZQUIERDA) ? 
                        COLOR_PAIR_COCHE_IZQ : COLOR_PAIR_COCHE_DER;
             
             int pos_x;
-            if (coches_visuales[i].direccion == IZQUIERDA) {
-                pos_x = start_x + 14 + (int)(coches_visuales[i].posicion * 50);
+            float posicion = posicion_coche(&coches[i], ahora_ms);
+            if (coches[i].direccion == IZQUIERDA) {
+                pos_x = start_x + 14 + (int)(posicion * 50);
             } else {
-                pos_x = start_x + 66 - (int)(coches_visuales[i].posicion * 50);
+                pos_x = start_x + 66 - (int)(posicion * 50);
             }
             
             attron(COLOR_PAIR(color) | A_BOLD);
-            mvprintw(start_y + 6, pos_x, "[%d]", coches_visuales[i].id % 100);
+            mvprintw(start_y + 6, pos_x, "[%d]", coches[i].id % 100);
             attroff(COLOR_PAIR(color) | A_BOLD);
         }
     }
-    pthread_mutex_unlock(&mutex_visuales);
-    
-    pthread_mutex_unlock(&monitor.mutex);
 }
 
-void dibujar_estadisticas(int start_y) {
+void dibujar_estadisticas(int start_y, const EstadoVisible* estado) {
     int max_y, max_x;
     getmaxyx(stdscr, max_y, max_x);
     int start_x = 2;
     
-    pthread_mutex_lock(&monitor.mutex);
+    limpiar_region(start_y, 0, 10, max_x);
     
     // Panel izquierdo - IZQUIERDA
     dibujar_caja(start_y, start_x, 10, 35, "LADO IZQUIERDO");
     
     attron(COLOR_PAIR(COLOR_PAIR_COCHE_IZQ) | A_BOLD);
-    mvprintw(start_y + 2, start_x + 2, "Esperando: %d", monitor.coches_esperando[IZQUIERDA]);
+    mvprintw(start_y + 2, start_x + 2, "Esperando: %d", estado->coches_esperando[IZQUIERDA]);
     mvprintw(start_y + 3, start_x + 2, "En puente: %d/%d", 
-             monitor.coches_en_puente[IZQUIERDA], MAX_COCHES_SIMULTANEOS);
+             estado->coches_en_puente[IZQUIERDA], MAX_COCHES_SIMULTANEOS);
     mvprintw(start_y + 4, start_x + 2, "Seguidos:  %d/%d", 
-             monitor.coches_seguidos[IZQUIERDA], MAX_COCHES_SEGUIDOS);
+             estado->coches_seguidos[IZQUIERDA], MAX_COCHES_SEGUIDOS);
     attroff(COLOR_PAIR(COLOR_PAIR_COCHE_IZQ) | A_BOLD);
     
     // Barra de ocupación izquierda
-    float ocupacion_izq = (float)monitor.coches_en_puente[IZQUIERDA] / MAX_COCHES_SIMULTANEOS;
+    float ocupacion_izq = (float)estado->coches_en_puente[IZQUIERDA] / MAX_COCHES_SIMULTANEOS;
     dibujar_barra_progreso(start_y + 6, start_x + 2, 20, ocupacion_izq, COLOR_PAIR_COCHE_IZQ);
     
     // Sensor izquierda (SENSOR DE ENTRADA)
-    bool sensor_izq_activo = (monitor.coches_esperando[IZQUIERDA] > 0);
+    bool sensor_izq_activo = (estado->coches_esperando[IZQUIERDA] > 0);
     if (sensor_izq_activo) {
         attron(COLOR_PAIR(COLOR_PAIR_SENSOR) | A_BOLD);
         mvprintw(start_y + 8, start_x + 2, "● SENSOR ACTIVO");
@@ -344,19 +710,19 @@ void dibujar_estadisticas(int start_y) {
     dibujar_caja(start_y, panel_der_x, 10, 35, "LADO DERECHO");
     
     attron(COLOR_PAIR(COLOR_PAIR_COCHE_DER) | A_BOLD);
-    mvprintw(start_y + 2, panel_der_x + 2, "Esperando: %d", monitor.coches_esperando[DERECHA]);
+    mvprintw(start_y + 2, panel_der_x + 2, "Esperando: %d", estado->coches_esperando[DERECHA]);
     mvprintw(start_y + 3, panel_der_x + 2, "En puente: %d/%d", 
-             monitor.coches_en_puente[DERECHA], MAX_COCHES_SIMULTANEOS);
+             estado->coches_en_puente[DERECHA], MAX_COCHES_SIMULTANEOS);
     mvprintw(start_y + 4, panel_der_x + 2, "Seguidos:  %d/%d", 
-             monitor.coches_seguidos[DERECHA], MAX_COCHES_SEGUIDOS);
+             estado->coches_seguidos[DERECHA], MAX_COCHES_SEGUIDOS);
     attroff(COLOR_PAIR(COLOR_PAIR_COCHE_DER) | A_BOLD);
     
     // Barra de ocupación derecha
-    float ocupacion_der = (float)monitor.coches_en_puente[DERECHA] / MAX_COCHES_SIMULTANEOS;
+    float ocupacion_der = (float)estado->coches_en_puente[DERECHA] / MAX_COCHES_SIMULTANEOS;
     dibujar_barra_progreso(start_y + 6, panel_der_x + 2, 20, ocupacion_der, COLOR_PAIR_COCHE_DER);
     
     // Sensor derecha (SENSOR DE ENTRADA)
-    bool sensor_der_activo = (monitor.coches_esperando[DERECHA] > 0);
+    bool sensor_der_activo = (estado->coches_esperando[DERECHA] > 0);
     if (sensor_der_activo) {
         attron(COLOR_PAIR(COLOR_PAIR_SENSOR) | A_BOLD);
         mvprintw(start_y + 8, panel_der_x + 2, "● SENSOR ACTIVO");
@@ -373,11 +739,11 @@ void dibujar_estadisticas(int start_y) {
     
     // Turno actual
     mvprintw(start_y + 2, panel_centro_x + 2, "Turno:");
-    if (monitor.turno == IZQUIERDA) {
+    if (estado->turno == IZQUIERDA) {
         attron(COLOR_PAIR(COLOR_PAIR_TURNO_IZQ) | A_BOLD);
         mvprintw(start_y + 2, panel_centro_x + 10, "← IZQUIERDA");
         attroff(COLOR_PAIR(COLOR_PAIR_TURNO_IZQ) | A_BOLD);
-    } else if (monitor.turno == DERECHA) {
+    } else if (estado->turno == DERECHA) {
         attron(COLOR_PAIR(COLOR_PAIR_TURNO_DER) | A_BOLD);
         mvprintw(start_y + 2, panel_centro_x + 10, "DERECHA →");
         attroff(COLOR_PAIR(COLOR_PAIR_TURNO_DER) | A_BOLD);
@@ -389,12 +755,12 @@ void dibujar_estadisticas(int start_y) {
     
     // Estadísticas
     attron(COLOR_PAIR(COLOR_PAIR_EXITO));
-    mvprintw(start_y + 4, panel_centro_x + 2, "Total generados: %d", monitor.total_generados);
-    mvprintw(start_y + 5, panel_centro_x + 2, "Total cruzados:  %d", monitor.total_cruzados);
+    mvprintw(start_y + 4, panel_centro_x + 2, "Total generados: %d", estado->total_generados);
+    mvprintw(start_y + 5, panel_centro_x + 2, "Total cruzados:  %d", estado->total_cruzados);
     attroff(COLOR_PAIR(COLOR_PAIR_EXITO));
     
     // Estado del sistema
-    if (monitor.pausado) {
+    if (estado->pausado) {
         attron(COLOR_PAIR(COLOR_PAIR_ALERTA) | A_BOLD);
         mvprintw(start_y + 7, panel_centro_x + 2, "⏸  PAUSADO");
         attroff(COLOR_PAIR(COLOR_PAIR_ALERTA) | A_BOLD);
@@ -403,26 +769,62 @@ void dibujar_estadisticas(int start_y) {
         mvprintw(start_y + 7, panel_centro_x + 2, "▶  ACTIVO");
         attroff(COLOR_PAIR(COLOR_PAIR_EXITO));
     }
-    
-    pthread_mutex_unlock(&monitor.mutex);
+}
+
+void formatear_log(const RegistroLog* registro, char* linea, size_t tamano) {
+    const char* hora = hora_de((time_t)(registro->tiempo_ms / 1000));
+    const char* dir = direccion_str((Direccion)registro->direccion);
+    switch (registro->tipo) {
+        case LOG_COLA:
+            snprintf(linea, tamano, "[%s] Sensor: Coche %d en cola %s", hora, registro->coche, dir);
+            break;
+        case LOG_ENTRA:
+            snprintf(linea, tamano, "[%s] Barrera abre: Coche %d ENTRA desde %s", hora, registro->coche, dir);
+            break;
+        case LOG_SALE:
+            snprintf(linea, tamano, "[%s] Sensor salida: Coche %d SALE del %s", hora, registro->coche, dir);
+            break;
+        default:
+            snprintf(linea, tamano, "[%s] %.*s", hora, TEXTO_LOG, registro->texto);
+            break;
+    }
 }
 
 void dibujar_log(int start_y) {
     int max_y, max_x;
     getmaxyx(stdscr, max_y, max_x);
     
-    dibujar_caja(start_y, 2, MAX_LOG_LINES + 2, max_x - 4, "LOG DE EVENTOS");
+    int desplazamiento = __atomic_load_n(&desplazamiento_log, __ATOMIC_RELAXED);
+    int maximo = (int)historial.num - MAX_LOG_LINES;
+    if (desplazamiento > maximo) desplazamiento = maximo;
+    if (desplazamiento < 0) desplazamiento = 0;
+    
+    char titulo[80];
+    unsigned long perdidos = __atomic_load_n(&log_perdidos, __ATOMIC_RELAXED);
+    if (desplazamiento > 0) {
+        snprintf(titulo, sizeof(titulo), "LOG DE EVENTOS - historial -%d de %zu", desplazamiento, historial.num);
+    } else if (perdidos > 0) {
+        snprintf(titulo, sizeof(titulo), "LOG DE EVENTOS - %lu perdidos", perdidos);
+    } else {
+        snprintf(titulo, sizeof(titulo), "LOG DE EVENTOS");
+    }
+    
+    limpiar_region(start_y, 2, MAX_LOG_LINES + 2, max_x - 4);
+    dibujar_caja(start_y, 2, MAX_LOG_LINES + 2, max_x - 4, titulo);
     
-    pthread_mutex_lock(&mutex_log);
+    // Las líneas más recientes quedan abajo, como en el buffer anterior
+    int primero = (int)historial.num - desplazamiento - MAX_LOG_LINES;
+    char linea[128];
+    attron(COLOR_PAIR(COLOR_PAIR_INFO));
     for (int i = 0; i < MAX_LOG_LINES; i++) {
-        int idx = (log_index + i) % MAX_LOG_LINES;
-        if (strlen(log_buffer[idx]) > 0) {
-            attron(COLOR_PAIR(COLOR_PAIR_INFO));
-            mvprintw(start_y + 1 + i, 4, "%s", log_buffer[idx]);
-            attroff(COLOR_PAIR(COLOR_PAIR_INFO));
+        int indice = primero + i;
+        if (indice < 0 || indice >= (int)historial.num) {
+            continue;
         }
+        formatear_log(&historial.registros[indice], linea, sizeof(linea));
+        mvaddnstr(start_y + 1 + i, 4, linea, max_x - 8);
     }
-    pthread_mutex_unlock(&mutex_log);
+    attroff(COLOR_PAIR(COLOR_PAIR_INFO));
 }
 
 void dibujar_controles() {
@@ -430,22 +832,106 @@ void dibujar_controles() {
     getmaxyx(stdscr, max_y, max_x);
     
     attron(COLOR_PAIR(COLOR_PAIR_TITULO));
-    mvprintw(max_y - 1, 2, "Controles: [I]zquierda [D]erecha [ESPACIO]Pausa [Q]uit");
+    mvprintw(max_y - 1, 2, "Controles: [I]zquierda [D]erecha [ESPACIO]Pausa [↑↓]Historial [Q]uit");
     attroff(COLOR_PAIR(COLOR_PAIR_TITULO));
 }
 
+// Espera a que cambie alguna de las versiones o a que venza el plazo.
+void esperar_cambios(unsigned monitor_dibujado, unsigned visuales_dibujado,
+                     unsigned log_dibujado, int plazo_ms) {
+    struct timespec limite;
+    clock_gettime(CLOCK_REALTIME, &limite);
+    limite.tv_sec += plazo_ms / 1000;
+    limite.tv_nsec += (long)(plazo_ms % 1000) * 1000000;
+    if (limite.tv_nsec >= 1000000000) {
+        limite.tv_sec++;
+        limite.tv_nsec -= 1000000000;
+    }
+    
+    pthread_mutex_lock(&mutex_render);
+    __atomic_store_n(&render_durmiendo, 1, __ATOMIC_SEQ_CST);
+    while (monitor.sistema_activo &&
+           leer_version(&version_monitor) == monitor_dibujado &&
+           leer_version(&version_visuales) == visuales_dibujado &&
+           leer_version(&version_log) == log_dibujado) {
+        if (pthread_cond_timedwait(&cond_render, &mutex_render, &limite) == ETIMEDOUT) {
+            break;
+        }
+    }
+    __atomic_store_n(&render_durmiendo, 0, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&mutex_render);
+}
+
 void* hilo_renderizado(void* arg) {
+    static Coche coches[MAX_COCHES_DIBUJADOS];
+    int alto = -1, ancho = -1;
+    int num_coches = 0;
+    // Versiones ya dibujadas; empiezan distintas para el primer cuadro.
+    unsigned monitor_dibujado = leer_version(&version_monitor) - 1;
+    unsigned visuales_dibujado = leer_version(&version_visuales) - 1;
+    unsigned log_dibujado = leer_version(&version_log) - 1;
+    
     while (monitor.sistema_activo) {
-        clear();
+        int max_y, max_x;
+        getmaxyx(stdscr, max_y, max_x);
+        bool completo = (max_y != alto || max_x != ancho);
+        
+        // Se leen antes de dibujar: un cambio durante el cuadro deja la
+        // version por delante y provoca otro cuadro.
+        unsigned v_monitor = leer_version(&version_monitor);
+        unsigned v_visuales = leer_version(&version_visuales);
+        unsigned v_log = leer_version(&version_log);
+        vaciar_log();
         
-        dibujar_header();
-        dibujar_puente(4);
-        dibujar_estadisticas(17);
-        dibujar_log(28);
-        dibujar_controles();
+        if (completo) {
+            clear();
+            alto = max_y;
+            ancho = max_x;
+            dibujar_header();
+            dibujar_controles();
+        }
+        // Los paneles se dibujan desde copias: ni los coches ni el monitor
+        // esperan a que termine un cuadro.
+        EstadoVisible estado;
+        leer_estado(&monitor, &estado);
+        
+        // Con coches cruzando el puente se redibuja en cada cuadro: sus
+        // posiciones dependen del reloj, no de ninguna versión.
+        bool animando = (num_coches > 0);
+        if (completo || animando || v_monitor != monitor_dibujado || v_visuales != visuales_dibujado) {
+            // Solo se copian los coches que están cruzando (pocos, aunque
+            // haya miles esperando)
+            pthread_mutex_lock(&mutex_visuales);
+            num_coches = 0;
+            for (uint32_t i = 0; i < registro.num_vivos && num_coches < MAX_COCHES_DIBUJADOS; i++) {
+                const Coche* coche = &registro_ranura(&registro, registro.densos[i])->coche;
+                if (coche->estado == CRUZANDO) {
+                    coches[num_coches++] = *coche;
+                }
+            }
+            pthread_mutex_unlock(&mutex_visuales);
+            
+            dibujar_puente(4, &estado, coches, num_coches, reloj_monotonico_ms());
+        }
+        if (completo || v_monitor != monitor_dibujado) {
+            dibujar_estadisticas(17, &estado);
+        }
+        if (completo || v_log != log_dibujado) {
+            dibujar_log(28);
+        }
+        monitor_dibujado = v_monitor;
+        visuales_dibujado = v_visuales;
+        log_dibujado = v_log;
         
+        // refresh() solo envia las celdas que difieren de la pantalla real.
         refresh();
-        usleep(50000); // 50ms = 20 FPS
+        
+        // Limitar la tasa de cuadros y, si nada se mueve, esperar al
+        // siguiente cambio.
+        usleep(INTERVALO_CUADRO_MS * 1000);
+        if (num_coches == 0) {
+            esperar_cambios(monitor_dibujado, visuales_dibujado, log_dibujado, ESPERA_INACTIVO_MS);
+        }
     }
     return NULL;
 }
@@ -455,20 +941,7 @@ void* hilo_renderizado(void* arg) {
 // ============================================================================
 
 int inicializar_monitor() {
-    // Inicializar mutex (EXCLUSIÓN MUTUA)
-    if (pthread_mutex_init(&monitor.mutex, NULL) != 0) {
-        perror("Error al inicializar mutex del monitor");
-        return -1;
-    }
-    
-    // Inicializar variables condicionales (ENTRADAS DEL MONITOR)
-    if (pthread_cond_init(&monitor.cola_izquierda, NULL) != 0) {
-        perror("Error al inicializar cola izquierda");
-        return -1;
-    }
-    
-    if (pthread_cond_init(&monitor.cola_derecha, NULL) != 0) {
-        perror("Error al inicializar cola derecha");
+    if (monitor_inicializar(&monitor) != 0) {
         return -1;
     }
     
@@ -476,183 +949,66 @@ int inicializar_monitor() {
         perror("Error al inicializar mutex visuales");
         return -1;
     }
+    registro_inicializar(&registro);
     
-    if (pthread_mutex_init(&mutex_log, NULL) != 0) {
-        perror("Error al inicializar mutex log");
-        return -1;
-    }
-    
-    // Inicializar estado del puente
-    monitor.coches_en_puente[IZQUIERDA] = 0;
-    monitor.coches_en_puente[DERECHA] = 0;
-    monitor.coches_esperando[IZQUIERDA] = 0;
-    monitor.coches_esperando[DERECHA] = 0;
-    monitor.coches_seguidos[IZQUIERDA] = 0;
-    monitor.coches_seguidos[DERECHA] = 0;
-    monitor.turno = NINGUNO;
-    monitor.total_cruzados = 0;
-    monitor.total_generados = 0;
-    monitor.sistema_activo = true;
-    monitor.pausado = false;
-    
-    memset(log_buffer, 0, sizeof(log_buffer));
+    inicializar_log();
     
     agregar_log("Monitor inicializado correctamente");
     return 0;
 }
 
 void destruir_monitor() {
-    pthread_mutex_destroy(&monitor.mutex);
-    pthread_cond_destroy(&monitor.cola_izquierda);
-    pthread_cond_destroy(&monitor.cola_derecha);
+    monitor_destruir(&monitor);
+    
+    // Los hilos de coche son independientes: si queda alguno vivo aún usa
+    // su ranura y el registro no se libera.
+    pthread_mutex_lock(&mutex_visuales);
+    if (registro.num_vivos == 0) {
+        registro_destruir(&registro);
+    }
+    pthread_mutex_unlock(&mutex_visuales);
     pthread_mutex_destroy(&mutex_visuales);
-    pthread_mutex_destroy(&mutex_log);
+    destruir_log();
 }
 
 // ============================================================================
-// PROCEDIMIENTOS DEL MONITOR (según caso de estudio)
+// PROCEDIMIENTOS DEL COCHE
 // ============================================================================
+// Cada uno llama al procedimiento del monitor (monitor_visual.h) y después,
+// ya fuera del mutex del monitor, avisa al renderizado, actualiza el estado
+// visual del coche y lo anota en el log.
 
-/**
- * PROCEDIMIENTO: llega_cola_izq / llega_cola_der
- * Registra la llegada de un coche a la cola (SENSOR DE ENTRADA)
- */
 void llega_cola(Coche* coche) {
-    pthread_mutex_lock(&monitor.mutex);
-    
-    monitor.coches_esperando[coche->direccion]++;
-    
-    pthread_mutex_unlock(&monitor.mutex);
+    monitor_llega_cola(&monitor, coche->direccion);
+    marcar_cambio(&version_monitor);
     
-    agregar_log("Sensor: Coche %d en cola %s", coche->id, direccion_str(coche->direccion));
+    log_coche(LOG_COLA, coche->id, coche->direccion);
 }
 
-/**
- * PROCEDIMIENTO: pasa_coche_izq / pasa_coche_der
- * ENTRADA CONDICIONAL - El coche espera hasta poder cruzar
- * Implementa las 4 condiciones del caso de estudio:
- * 1. No hay coches del sentido contrario
- * 2. No se supera la capacidad máxima
- * 3. Se respeta el límite de coches seguidos
- * 4. Se tiene el turno correspondiente
- */
 void pasa_coche(Coche* coche) {
-    pthread_mutex_lock(&monitor.mutex);
-    
-    Direccion mi_dir = coche->direccion;
-    Direccion otra_dir = (mi_dir == IZQUIERDA) ? DERECHA : IZQUIERDA;
-    pthread_cond_t* mi_cola = (mi_dir == IZQUIERDA) ? 
-                              &monitor.cola_izquierda : &monitor.cola_derecha;
-    
-    // ESPERAR hasta que se cumplan TODAS las condiciones
-    while (true) {
-        // Condición de pausa
-        if (monitor.pausado) {
-            pthread_cond_wait(mi_cola, &monitor.mutex);
-            continue;
-        }
-        
-        // Condición 1: Verificar turno
-        bool es_mi_turno = (monitor.turno == mi_dir || monitor.turno == NINGUNO);
-        
-        // Condición 2: No hay coches del otro lado (EXCLUSIÓN MUTUA)
-        bool puente_libre = (monitor.coches_en_puente[otra_dir] == 0);
-        
-        // Condición 3: Capacidad no superada
-        bool hay_capacidad = (monitor.coches_en_puente[mi_dir] < MAX_COCHES_SIMULTANEOS);
-        
-        // Condición 4: No se superó límite de seguidos (evitar INANICIÓN)
-        bool puede_pasar_seguido = true;
-        if (monitor.coches_esperando[otra_dir] > 0) {
-            puede_pasar_seguido = (monitor.coches_seguidos[mi_dir] < MAX_COCHES_SEGUIDOS);
-        }
-        
-        // Si todas las condiciones se cumplen, puede pasar
-        if (es_mi_turno && puente_libre && hay_capacidad && puede_pasar_seguido) {
-            break;
-        }
-        
-        // Si no puede pasar, espera en la cola condicional
-        pthread_cond_wait(mi_cola, &monitor.mutex);
-    }
-    
-    // === SECCIÓN CRÍTICA: CRUZAR EL PUENTE ===
-    
-    // Asignar turno si no hay ninguno
-    if (monitor.turno == NINGUNO) {
-        monitor.turno = mi_dir;
-    }
-    
-    // Actualizar contadores
-    monitor.coches_esperando[mi_dir]--;
-    monitor.coches_en_puente[mi_dir]++;
-    
-    // Incrementar contador de seguidos solo si hay cola en el otro lado
-    if (monitor.coches_esperando[otra_dir] > 0) {
-        monitor.coches_seguidos[mi_dir]++;
-    }
+    monitor_pasa_coche(&monitor, coche->direccion);
+    marcar_cambio(&version_monitor);
     
+    // El estado visual del coche no es parte del monitor
+    pthread_mutex_lock(&mutex_visuales);
     coche->estado = CRUZANDO;
-    coche->posicion = 0.0f;
-    coche->tiempo_inicio_cruce = time(NULL);
-    
-    pthread_mutex_unlock(&monitor.mutex);
+    coche->tiempo_inicio_cruce = reloj_monotonico_ms();
+    pthread_mutex_unlock(&mutex_visuales);
+    marcar_cambio(&version_visuales);
     
-    agregar_log("Barrera abre: Coche %d ENTRA desde %s", coche->id, direccion_str(mi_dir));
+    log_coche(LOG_ENTRA, coche->id, coche->direccion);
 }
 
-/**
- * PROCEDIMIENTO: sale_coche_izq / sale_coche_der
- * Registra la salida del coche (SENSOR DE SALIDA)
- * Gestiona cambios de turno para evitar inanición
- */
 void sale_coche(Coche* coche) {
-    pthread_mutex_lock(&monitor.mutex);
-    
-    Direccion mi_dir = coche->direccion;
-    Direccion otra_dir = (mi_dir == IZQUIERDA) ? DERECHA : IZQUIERDA;
+    monitor_sale_coche(&monitor, coche->direccion);
+    marcar_cambio(&version_monitor);
     
-    // Actualizar contadores
-    monitor.coches_en_puente[mi_dir]--;
-    monitor.total_cruzados++;
+    pthread_mutex_lock(&mutex_visuales);
     coche->estado = FINALIZADO;
     coche->tiempo_salida = time(NULL);
+    pthread_mutex_unlock(&mutex_visuales);
     
-    // Si soy el último de mi lado en el puente
-    if (monitor.coches_en_puente[mi_dir] == 0) {
-        
-        // Reiniciar contador de seguidos si llegó al límite
-        if (monitor.coches_seguidos[mi_dir] >= MAX_COCHES_SEGUIDOS) {
-            monitor.coches_seguidos[mi_dir] = 0;
-        }
-        
-        // Cambiar turno si hay coches esperando del otro lado (evitar INANICIÓN)
-        if (monitor.coches_esperando[otra_dir] > 0) {
-            monitor.turno = otra_dir;
-            
-            // Despertar a los coches del otro lado
-            if (otra_dir == IZQUIERDA) {
-                pthread_cond_broadcast(&monitor.cola_izquierda);
-            } else {
-                pthread_cond_broadcast(&monitor.cola_derecha);
-            }
-        } else {
-            // Si no hay nadie esperando, liberar el turno
-            monitor.turno = NINGUNO;
-            monitor.coches_seguidos[mi_dir] = 0;
-        }
-    } else {
-        // Aún hay coches de mi lado, despertar al siguiente de mi cola
-        if (mi_dir == IZQUIERDA) {
-            pthread_cond_signal(&monitor.cola_izquierda);
-        } else {
-            pthread_cond_signal(&monitor.cola_derecha);
-        }
-    }
-    
-    pthread_mutex_unlock(&monitor.mutex);
-    
-    agregar_log("Sensor salida: Coche %d SALE del %s", coche->id, direccion_str(mi_dir));
+    log_coche(LOG_SALE, coche->id, coche->direccion);
 }
 
 // ============================================================================
@@ -660,11 +1016,21 @@ void sale_coche(Coche* coche) {
 // ============================================================================
 
 void* tarea_coche(void* arg) {
-    Coche* coche = (Coche*)arg;
+    ManejadorCoche manejador = (ManejadorCoche)(uintptr_t)arg;
+    
+    // La dirección de la ranura es estable mientras el coche siga registrado
+    pthread_mutex_lock(&mutex_visuales);
+    Coche* coche = registro_obtener(&registro, manejador);
+    pthread_mutex_unlock(&mutex_visuales);
+    if (coche == NULL) {
+        return NULL;
+    }
     
     // Fase 1: Llegar al puente (SENSOR DE ENTRADA detecta)
+    pthread_mutex_lock(&mutex_visuales);
     coche->tiempo_llegada = time(NULL);
     coche->estado = ESPERANDO;
+    pthread_mutex_unlock(&mutex_visuales);
     llega_cola(coche);
     
     // Pequeña pausa para simular tiempo de llegada
@@ -673,14 +1039,11 @@ void* tarea_coche(void* arg) {
     // Fase 2: Esperar y cruzar el puente (ENTRADA CONDICIONAL)
     pasa_coche(coche);
     
-    // Fase 3: Animación del cruce con actualización de posición
-    int pasos = 40;
-    for (int i = 0; i <= pasos; i++) {
-        pthread_mutex_lock(&mutex_visuales);
-        coche->posicion = (float)i / pasos;
-        pthread_mutex_unlock(&mutex_visuales);
-        
-        usleep(TIEMPO_CRUCE_MS * 1000 / pasos);
+    // Fase 3: Cruzar. El renderizado anima el coche a partir de
+    // tiempo_inicio_cruce; el hilo solo duerme hasta el final del cruce.
+    int64_t fin_cruce_ms = coche->tiempo_inicio_cruce + tiempo_cruce_ms;
+    struct timespec fin_cruce = { (time_t)(fin_cruce_ms / 1000), (long)(fin_cruce_ms % 1000) * 1000000 };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &fin_cruce, NULL) == EINTR) {
     }
     
     // Fase 4: Salir del puente (SENSOR DE SALIDA detecta)
@@ -688,17 +1051,9 @@ void* tarea_coche(void* arg) {
     
     // Remover de visuales
     pthread_mutex_lock(&mutex_visuales);
-    for (int i = 0; i < num_coches_visuales; i++) {
-        if (coches_visuales[i].id == coche->id) {
-            // Mover el último al lugar del actual
-            if (i < num_coches_visuales - 1) {
-                coches_visuales[i] = coches_visuales[num_coches_visuales - 1];
-            }
-            num_coches_visuales--;
-            break;
-        }
-    }
+    registro_eliminar(&registro, manejador);
     pthread_mutex_unlock(&mutex_visuales);
+    marcar_cambio(&version_visuales);
     
     return NULL;
 }
@@ -708,33 +1063,42 @@ void* tarea_coche(void* arg) {
 // ============================================================================
 
 void agregar_coche_manual(Direccion direccion) {
-    if (num_coches_visuales >= MAX_COCHES_VISUALES) {
-        agregar_log("ERROR: Máximo de coches alcanzado");
-        return;
-    }
+    static int id_counter = 1;
     
     pthread_mutex_lock(&mutex_visuales);
     
-    static int id_counter = 1;
-    Coche* coche = &coches_visuales[num_coches_visuales];
-    coche->id = id_counter++;
-    coche->direccion = direccion;
-    coche->estado = ESPERANDO;
-    coche->posicion = 0.0f;
-    num_coches_visuales++;
+    Coche* coche;
+    ManejadorCoche manejador = registro_insertar(&registro, &coche);
+    if (manejador != COCHE_NULO) {
+        coche->id = id_counter++;
+        coche->direccion = direccion;
+        coche->estado = ESPERANDO;
+    }
     
     pthread_mutex_unlock(&mutex_visuales);
     
-    pthread_mutex_lock(&monitor.mutex);
-    monitor.total_generados++;
-    pthread_mutex_unlock(&monitor.mutex);
+    if (manejador == COCHE_NULO) {
+        agregar_log("ERROR: Máximo de coches alcanzado");
+        return;
+    }
+    marcar_cambio(&version_visuales);
     
     pthread_t hilo;
-    if (pthread_create(&hilo, NULL, tarea_coche, coche) != 0) {
-        perror("Error al crear hilo del coche");
+    if (pthread_create(&hilo, NULL, tarea_coche, (void*)(uintptr_t)manejador) != 0) {
+        agregar_log("ERROR: No se pudo crear el hilo del coche");
+        pthread_mutex_lock(&mutex_visuales);
+        registro_eliminar(&registro, manejador);
+        pthread_mutex_unlock(&mutex_visuales);
+        marcar_cambio(&version_visuales);
         return;
     }
     pthread_detach(hilo);
+    
+    pthread_mutex_lock(&monitor.mutex);
+    monitor.total_generados++;
+    publicar_estado(&monitor);
+    pthread_mutex_unlock(&monitor.mutex);
+    marcar_cambio(&version_monitor);
 }
 
 // ============================================================================
@@ -745,15 +1109,15 @@ void* generador_automatico(void* arg) {
     agregar_log("Generador automático iniciado");
     
     while (monitor.sistema_activo) {
-        if (!monitor.pausado && num_coches_visuales < MAX_COCHES_VISUALES - 2) {
+        if (!monitor.pausado) {
             // Generar aleatoriamente coches
-            if (rand() % 100 < 30) { // 30% probabilidad cada ciclo
+            if (rand() % 100 < probabilidad_generador) { // 30% por defecto cada ciclo
                 Direccion dir = (rand() % 2 == 0) ? IZQUIERDA : DERECHA;
                 agregar_coche_manual(dir);
             }
         }
         
-        sleep(2); // Cada 2 segundos
+        usleep(periodo_generador_ms * 1000); // Cada 2 segundos por defecto
     }
     
     return NULL;
@@ -799,7 +1163,27 @@ void* hilo_input(void* arg) {
                     pthread_cond_broadcast(&monitor.cola_izquierda);
                     pthread_cond_broadcast(&monitor.cola_derecha);
                 }
+                publicar_estado(&monitor);
                 pthread_mutex_unlock(&monitor.mutex);
+                marcar_cambio(&version_monitor);
+                break;
+                
+            // Historial del log
+            case KEY_UP:
+                desplazar_log(1);
+                break;
+            case KEY_DOWN:
+                desplazar_log(-1);
+                break;
+            case KEY_PPAGE:
+                desplazar_log(MAX_LOG_LINES);
+                break;
+            case KEY_NPAGE:
+                desplazar_log(-MAX_LOG_LINES);
+                break;
+            case KEY_END:
+                __atomic_store_n(&desplazamiento_log, 0, __ATOMIC_RELAXED);
+                marcar_cambio(&version_log);
                 break;
         }
         
@@ -809,13 +1193,208 @@ void* hilo_input(void* arg) {
     return NULL;
 }
 
+// ============================================================================
+// MODO SIN INTERFAZ
+// ============================================================================
+
+typedef enum { METRICAS_JSON, METRICAS_CSV } FormatoMetricas;
+
+typedef struct {
+    FormatoMetricas formato;
+    int fd;
+    int intervalo_ms;
+    double duracion_s;      // 0: hasta recibir SIGINT o SIGTERM
+} ConfiguracionSinInterfaz;
+
+volatile sig_atomic_t fin_solicitado = 0;
+
+void manejar_fin(int senal) {
+    (void)senal;
+    fin_solicitado = 1;
+}
+
+bool escribir_metricas(int fd, const char* texto, size_t tamano) {
+    while (tamano > 0) {
+        ssize_t n = write(fd, texto, tamano);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        texto += n;
+        tamano -= n;
+    }
+    return true;
+}
+
+bool emitir_metricas(const ConfiguracionSinInterfaz* cfg, double t, double cruces_por_s,
+                     const EstadoVisible* e, unsigned vivos) {
+    char linea[512];
+    int n;
+    unsigned long perdidos = __atomic_load_n(&log_perdidos, __ATOMIC_RELAXED);
+    if (cfg->formato == METRICAS_JSON) {
+        n = snprintf(linea, sizeof(linea),
+                     "{\"t\":%.3f,\"generados\":%d,\"cruzados\":%d,\"cruces_s\":%.3f,"
+                     "\"esperando\":[%d,%d],\"en_puente\":[%d,%d],\"seguidos\":[%d,%d],"
+                     "\"turno\":\"%s\",\"vivos\":%u,\"log_perdidos\":%lu}\n",
+                     t, e->total_generados, e->total_cruzados, cruces_por_s,
+                     e->coches_esperando[IZQUIERDA], e->coches_esperando[DERECHA],
+                     e->coches_en_puente[IZQUIERDA], e->coches_en_puente[DERECHA],
+                     e->coches_seguidos[IZQUIERDA], e->coches_seguidos[DERECHA],
+                     direccion_str((Direccion)e->turno), vivos, perdidos);
+    } else {
+        n = snprintf(linea, sizeof(linea), "%.3f,%d,%d,%.3f,%d,%d,%d,%d,%d,%d,%s,%u,%lu\n",
+                     t, e->total_generados, e->total_cruzados, cruces_por_s,
+                     e->coches_esperando[IZQUIERDA], e->coches_esperando[DERECHA],
+                     e->coches_en_puente[IZQUIERDA], e->coches_en_puente[DERECHA],
+                     e->coches_seguidos[IZQUIERDA], e->coches_seguidos[DERECHA],
+                     direccion_str((Direccion)e->turno), vivos, perdidos);
+    }
+    return escribir_metricas(cfg->fd, linea, (size_t)n);
+}
+
+// Mismo motor que la interfaz (generador_automatico y tarea_coche) sin
+// ncurses: el hilo principal toma la instantánea del monitor cada intervalo
+// y la escribe como una línea JSON o CSV.
+int ejecutar_sin_interfaz(const ConfiguracionSinInterfaz* cfg) {
+    historial_activo = false;
+    if (inicializar_monitor() != 0) {
+        fprintf(stderr, "Error crítico: No se pudo inicializar el monitor\n");
+        return EXIT_FAILURE;
+    }
+    
+    struct sigaction accion;
+    memset(&accion, 0, sizeof(accion));
+    accion.sa_handler = manejar_fin;
+    sigaction(SIGINT, &accion, NULL);
+    sigaction(SIGTERM, &accion, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    
+    pthread_t hilo_gen;
+    if (pthread_create(&hilo_gen, NULL, generador_automatico, NULL) != 0) {
+        perror("Error al crear hilo generador");
+        return EXIT_FAILURE;
+    }
+    
+    if (cfg->formato == METRICAS_CSV) {
+        const char* cabecera = "t,generados,cruzados,cruces_s,esperando_izq,esperando_der,"
+                               "en_puente_izq,en_puente_der,seguidos_izq,seguidos_der,turno,vivos,log_perdidos\n";
+        escribir_metricas(cfg->fd, cabecera, strlen(cabecera));
+    }
+    
+    int64_t inicio = reloj_monotonico_ms();
+    int64_t siguiente = inicio + cfg->intervalo_ms;
+    int64_t anterior = inicio;
+    int cruzados_antes = 0;
+    bool salida_valida = true;
+    
+    while (!fin_solicitado && salida_valida) {
+        int64_t ahora = reloj_monotonico_ms();
+        if (cfg->duracion_s > 0 && ahora - inicio >= (int64_t)(cfg->duracion_s * 1000)) {
+            break;
+        }
+        if (ahora < siguiente) {
+            // Tramos cortos para atender la señal de fin a tiempo
+            int64_t espera = siguiente - ahora;
+            usleep((useconds_t)((espera < 100 ? espera : 100) * 1000));
+            continue;
+        }
+        siguiente += cfg->intervalo_ms;
+        vaciar_log();
+        
+        EstadoVisible estado;
+        leer_estado(&monitor, &estado);
+        pthread_mutex_lock(&mutex_visuales);
+        unsigned vivos = registro.num_vivos;
+        pthread_mutex_unlock(&mutex_visuales);
+        
+        double dt = (ahora - anterior) / 1000.0;
+        double cruces_por_s = dt > 0 ? (estado.total_cruzados - cruzados_antes) / dt : 0.0;
+        salida_valida = emitir_metricas(cfg, (ahora - inicio) / 1000.0, cruces_por_s, &estado, vivos);
+        anterior = ahora;
+        cruzados_antes = estado.total_cruzados;
+    }
+    
+    monitor.sistema_activo = false;
+    pthread_join(hilo_gen, NULL);
+    
+    // Línea final con el estado al terminar
+    if (salida_valida) {
+        int64_t ahora = reloj_monotonico_ms();
+        EstadoVisible estado;
+        leer_estado(&monitor, &estado);
+        pthread_mutex_lock(&mutex_visuales);
+        unsigned vivos = registro.num_vivos;
+        pthread_mutex_unlock(&mutex_visuales);
+        double dt = (ahora - anterior) / 1000.0;
+        double cruces_por_s = dt > 0 ? (estado.total_cruzados - cruzados_antes) / dt : 0.0;
+        salida_valida = emitir_metricas(cfg, (ahora - inicio) / 1000.0, cruces_por_s, &estado, vivos);
+    }
+    
+    // Los coches en curso siguen siendo hilos independientes: el proceso
+    // termina sin destruir el monitor que aún usan.
+    return salida_valida ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void mostrar_uso(const char* programa) {
+    fprintf(stderr,
+            "Uso: %s [--sin-interfaz [--formato json|csv] [--fd N] [--intervalo MS]\n"
+            "        [--duracion S] [--periodo MS] [--probabilidad P] [--cruce MS] [--semilla N]]\n",
+            programa);
+}
+
 // ============================================================================
 // FUNCIÓN PRINCIPAL
 // ============================================================================
 
 int main(int argc, char* argv[]) {
+    bool sin_interfaz = false;
+    unsigned semilla = (unsigned)time(NULL);
+    ConfiguracionSinInterfaz cfg = { METRICAS_JSON, STDOUT_FILENO, 1000, 0.0 };
+    
+    for (int i = 1; i < argc; i++) {
+        const char* opcion = argv[i];
+        const char* valor = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(opcion, "--sin-interfaz") == 0) {
+            sin_interfaz = true;
+            continue;
+        }
+        if (valor == NULL) {
+            mostrar_uso(argv[0]);
+            return EXIT_FAILURE;
+        }
+        if (strcmp(opcion, "--formato") == 0 && strcmp(valor, "json") == 0) {
+            cfg.formato = METRICAS_JSON;
+        } else if (strcmp(opcion, "--formato") == 0 && strcmp(valor, "csv") == 0) {
+            cfg.formato = METRICAS_CSV;
+        } else if (strcmp(opcion, "--fd") == 0) {
+            cfg.fd = atoi(valor);
+        } else if (strcmp(opcion, "--intervalo") == 0) {
+            cfg.intervalo_ms = atoi(valor) > 0 ? atoi(valor) : 1000;
+        } else if (strcmp(opcion, "--duracion") == 0) {
+            cfg.duracion_s = atof(valor);
+        } else if (strcmp(opcion, "--periodo") == 0) {
+            periodo_generador_ms = atoi(valor) > 0 ? atoi(valor) : PERIODO_GENERADOR_MS;
+        } else if (strcmp(opcion, "--probabilidad") == 0) {
+            probabilidad_generador = atoi(valor);
+        } else if (strcmp(opcion, "--cruce") == 0) {
+            tiempo_cruce_ms = atoi(valor) > 0 ? atoi(valor) : TIEMPO_CRUCE_MS;
+        } else if (strcmp(opcion, "--semilla") == 0) {
+            semilla = (unsigned)strtoul(valor, NULL, 10);
+        } else {
+            mostrar_uso(argv[0]);
+            return EXIT_FAILURE;
+        }
+        i++;
+    }
+    
     // Inicializar semilla aleatoria
-    srand(time(NULL));
+    srand(semilla);
+    
+    if (sin_interfaz) {
+        if (fcntl(cfg.fd, F_GETFD) == -1) {
+            fprintf(stderr, "Descriptor de métricas no válido: %d\n", cfg.fd);
+            return EXIT_FAILURE;
+        }
+        return ejecutar_sin_interfaz(&cfg);
+    }
     
     // Inicializar ncurses
     initscr();
@@ -887,6 +1466,7 @@ int main(int argc, char* argv[]) {
     
     // Señalar fin del sistema
     monitor.sistema_activo = false;
+    despertar_render();
     
     // Despertar todos los hilos bloqueados
     pthread_mutex_lock(&monitor.mutex);
@@ -11,6 +11,8 @@
 #include <stdbool.h>
 #include <stdarg.h>
 
+#include "reloj.h"
+
 // ============================================================================
 // CÓDIGOS DE COLOR ANSI (sin librerías externas)
 // ============================================================================
@@ -114,17 +116,8 @@ const char* direccion_color(Direccion dir) {
     }
 }
 
-void obtener_timestamp(char* buffer, size_t size) {
-    time_t now = time(NULL);
-    struct tm* tm_info = localtime(&now);
-    strftime(buffer, size, "%H:%M:%S", tm_info);
-}
-
 void log_evento(const char* formato, ...) {
-    char timestamp[20];
-    obtener_timestamp(timestamp, sizeof(timestamp));
-    
-    printf(DIM "[%s]" RESET " ", timestamp);
+    printf(DIM "[%s]" RESET " ", hora_actual());
     
     va_list args;
     va_start(args, formato);
@@ -13,372 +13,512 @@
 #include <limits>   
 #include <cstdlib>
 #include <algorithm> 
+#include <queue>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+#include "registro_asincrono.h"
+#include "reloj.h"
+#include "histograma.h"
+#include "traza.h"
+#include "carga.h"
+#include "metricas.h"
+#include "monitor_puente.h"
 
 using namespace std;
 
-#define MAX_COCHES_SIMULTANEOS 3
-#define MAX_COCHES_SEGUIDOS 5
 #define TOTAL_COCHES_POR_LADO 8
 #define TIEMPO_CRUCE_MS 2000
 
-#define MAX_PESO_TON 20
-#define MAX_ALTURA_M 4 
+#define RETARDO_COLA_MAX_MS 500
+#define LLEGADA_MIN_MS 500
+#define LLEGADA_RANGO_MS 1500
+#define TIEMPO_INTERVENCION_MS 5000
 
-enum Direccion { IZQUIERDA = 0, DERECHA = 1, NINGUNO = 2 };
-enum EstadoCoche { ESPERANDO, CRUZANDO, FINALIZADO, RECHAZADO }; 
+// Flujos aleatorios de la simulacion con hilos (ver carga.h): uno por
+// generador de cada sentido y otro para el detector de fallas.
+#define FLUJO_FALLAS 2
 
-struct Coche {
-    int id;
-    Direccion direccion;
-    EstadoCoche estado;
-    chrono::time_point<chrono::system_clock> tiempo_llegada;
-    chrono::time_point<chrono::system_clock> tiempo_inicio_cruce;
-    chrono::time_point<chrono::system_clock> tiempo_salida;
-
-    int peso_toneladas;         
-    int altura_metros;          
-    bool falla_mecanica_grave;  
+struct ParametrosSimulacion {
+    int coches_por_lado = TOTAL_COCHES_POR_LADO;
+    int tiempo_cruce_ms = TIEMPO_CRUCE_MS;
+    int retardo_cola_max_ms = RETARDO_COLA_MAX_MS;
+    int llegada_min_ms = LLEGADA_MIN_MS;
+    int llegada_rango_ms = LLEGADA_RANGO_MS;
+    bool coches_defectuosos = true;
+    uint64_t semilla = 0;
+    ConfiguracionCarga carga;
+    const FicheroLlegadas* llegadas_grabadas = nullptr;    // si no es nulo sustituye a la carga
+    double velocidad_llegadas = 1.0;                        // 0: sin esperas (solo modos con hilos)
 };
 
-string get_timestamp() {
-    auto now = chrono::system_clock::to_time_t(chrono::system_clock::now());
-    tm tm_info;
-    #ifdef _WIN32
-        localtime_s(&tm_info, &now);
-    #else
-        localtime_r(&now, &tm_info);
-    #endif
-    stringstream ss;
-    ss << put_time(&tm_info, "%H:%M:%S");
-    return ss.str();
-}
+ParametrosSimulacion parametros;
+
+// Monitor de la simulacion con hilos (ver monitor_puente.h)
+MonitorPuente monitor;
 
-string direccion_str(Direccion dir) {
-    switch(dir) {
-        case IZQUIERDA: return "IZQUIERDA";
-        case DERECHA: return "DERECHA";
-        default: return "NINGUNO";
+void log_evento(const string& mensaje) {
+    if (!registro_habilitado || monitor.sistema_en_pausa) {
+        return; 
+    }
+    RegistroMonitor r = {};
+    r.instante_ms = reloj_ms();
+    r.tipo = REG_TEXTO;
+    // Se recorta sin partir un caracter UTF-8.
+    size_t n = min(mensaje.size(), (size_t)TEXTO_REGISTRO - 1);
+    while (n > 0 && n < mensaje.size() && (mensaje[n] & 0xC0) == 0x80) {
+        n--;
     }
+    memcpy(r.texto, mensaje.data(), n);
+    r.texto[n] = '\0';
+    publicar_registro(r);
 }
 
-void log_evento(const string& mensaje);
-
-class MonitorPuente {
-private:
-    bool puente_bloqueado = false;      
-    bool sensor_izq_ok = true;     
-    bool sensor_der_ok = true;     
-    bool barrera_izq_ok = true;    
-    bool barrera_der_ok = true;    
+void tarea_coche(Coche* coche) {
+    coche->tiempo_llegada = chrono::steady_clock::now();
+    coche->estado = ESPERANDO;
     
-    int coches_en_puente[2] = {0, 0};
-    int coches_esperando[2] = {0, 0};
-    int coches_seguidos[2] = {0, 0};
-    Direccion turno = NINGUNO;
+    monitor.llega_cola(coche);
+    if (coche->retardo_cola_ms > 0) {
+        this_thread::sleep_for(chrono::milliseconds(coche->retardo_cola_ms));
+    }
     
-    string causa_bloqueo = "N/A"; 
-public:
-    mutex mtx; 
-    condition_variable cola_izquierda;
-    condition_variable cola_derecha;
-    condition_variable cv_apagado; 
+    monitor.pasa_coche(coche);
     
-    int total_cruzados = 0;
-    int total_generados = 0;
-    atomic<bool> sistema_activo;
-    atomic<bool> sistema_en_pausa; 
-
-    MonitorPuente() {
-        sistema_activo = true;
-        sistema_en_pausa = false;
-        cerr << "[" << get_timestamp() << "] Monitor del puente inicializado correctamente" << endl;
+    if (!monitor.sistema_activo) {
+        return; 
     }
+    
+    if (coche->estado == RECHAZADO) {
+        log_evento("Coche " + to_string(coche->id) + " RECHAZADO y desalojado. Finaliza hilo.");
+    } else if (coche->estado == CRUZANDO) {
+        this_thread::sleep_for(chrono::milliseconds(parametros.tiempo_cruce_ms));
+        monitor.sale_coche(coche);
+    } 
+}
 
-    void set_sensor_ok(Direccion dir, bool estado) {
-        lock_guard<mutex> lock(mtx);
-        if (dir == IZQUIERDA) {
-            sensor_izq_ok = estado;
-        } else {
-            sensor_der_ok = estado;
+void preparar_coche(Coche& coche, int id, Direccion direccion, mt19937& gen, bool defectuosos = parametros.coches_defectuosos) {
+    uniform_int_distribution<> prob_problema(1, 5);
+    uniform_int_distribution<> tipo_dist(0, 2);
+    uniform_int_distribution<> peso_dist(10, 30);
+    uniform_int_distribution<> altura_dist(3, 6);
+
+    coche.id = id;
+    coche.direccion = direccion;
+    coche.estado = ESPERANDO;
+    coche.continuacion = nullptr;
+    coche.espera = nullptr;
+    
+    coche.peso_toneladas = peso_dist(gen);
+    coche.altura_metros = altura_dist(gen);
+    coche.falla_mecanica_grave = false;
+
+    if (defectuosos && prob_problema(gen) == 1) { 
+        int tipo_problema = tipo_dist(gen);
+        if (tipo_problema == 0) coche.peso_toneladas = MAX_PESO_TON + 1;
+        else if (tipo_problema == 1) coche.altura_metros = MAX_ALTURA_M + 1;
+        else coche.falla_mecanica_grave = true;
+
+        if (registro_habilitado) {
+            log_evento("Generando Coche " + to_string(coche.id) + " con FALSA CAPACIDAD.");
         }
+    } else {
+        coche.peso_toneladas = peso_dist(gen) % (MAX_PESO_TON - 1) + 1;
+        coche.altura_metros = altura_dist(gen) % (MAX_ALTURA_M - 1) + 1;
+        coche.peso_toneladas = max(1, coche.peso_toneladas); 
+        coche.altura_metros = max(1, coche.altura_metros); 
     }
+}
 
-    void set_barrera_ok(Direccion dir, bool estado) {
-        lock_guard<mutex> lock(mtx);
-        if (dir == IZQUIERDA) {
-            barrera_izq_ok = estado;
-        } else {
-            barrera_der_ok = estado;
+// Origen de los coches de un sentido: sorteados con la carga configurada o,
+// si hay fichero de llegadas, leidos de el en orden. Todos los sorteos de un
+// coche salen del flujo propio de la fuente, asi que la misma semilla da los
+// mismos coches aunque cambie el reparto de los hilos.
+class FuenteCoches {
+private:
+    const ParametrosSimulacion& params;
+    Direccion direccion;
+    mt19937 gen;
+    ProcesoLlegadas llegadas;
+    CursorLlegadas cursor;
+    double instante_ms = 0;
+    int generados = 0;
+
+public:
+    FuenteCoches(const ParametrosSimulacion& p, Direccion dir, uint64_t semilla)
+        : params(p), direccion(dir), gen(flujo_aleatorio(semilla, dir)),
+          llegadas(p.carga, dir, p.llegada_min_ms, p.llegada_rango_ms) {
+        if (params.llegadas_grabadas) {
+            cursor = CursorLlegadas(*params.llegadas_grabadas, dir);
         }
     }
-    
-    string get_causa_bloqueo() {
-        lock_guard<mutex> lock(mtx);
-        return causa_bloqueo;
-    }
 
-    void mostrar_estado() {
-        lock_guard<mutex> lock(mtx);
-        cout << "\n";
-        cout << "============================================================\n";
-        cout << "               ESTADO ACTUAL DEL PUENTE DUERO               \n";
-        cout << "------------------------------------------------------------\n";
-        cout << "ESTADO GLOBAL:         " << (puente_bloqueado ? "BLOQUEADO/SUSPENDIDO" : "OPERATIVO") << "\n";
-        if (puente_bloqueado) {
-             cout << "CAUSA DEL BLOQUEO:     " << causa_bloqueo << "\n";
-        }
-        cout << "Turno actual:          " << direccion_str(turno) << "\n";
-        cout << "Componentes IZQ:       Sensor (" << (sensor_izq_ok ? "OK" : "FALLA") << ") | Barrera (" << (barrera_izq_ok ? "OK" : "FALLA") << ")\n";
-        cout << "Componentes DER:       Sensor (" << (sensor_der_ok ? "OK" : "FALLA") << ") | Barrera (" << (barrera_der_ok ? "OK" : "FALLA") << ")\n";
-        cout << "Coches en puente IZQ:  " << coches_en_puente[IZQUIERDA] << "\n";
-        cout << "Coches en puente DER:  " << coches_en_puente[DERECHA] << "\n";
-        cout << "Coches esperando IZQ:  " << coches_esperando[IZQUIERDA] << "\n";
-        cout << "Coches esperando DER:  " << coches_esperando[DERECHA] << "\n";
-        cout << "Total cruzados:        " << total_cruzados << "\n";
-        cout << "============================================================\n";
-        cout << "\n";
-    }
-
-    void llega_cola(Coche* coche);
-    void pasa_coche(Coche* coche);
-    void sale_coche(Coche* coche);
-
-    void iniciar_bloqueo_puente(const string& causa) {
-        lock_guard<mutex> lock(mtx); 
-        puente_bloqueado = true;
-        causa_bloqueo = causa;
-    }
-
-    bool is_puente_bloqueado() {
-        lock_guard<mutex> lock(mtx);
-        return puente_bloqueado;
-    }
+    // Prepara el siguiente coche y devuelve en `llegada_ms` su instante de
+    // llegada desde el inicio. Devuelve false si no quedan coches.
+    bool siguiente(Coche& coche, int64_t& llegada_ms) {
+        int id = (direccion * 100) + generados + 1;
+        if (params.llegadas_grabadas) {
+            const LlegadaGrabada* r = cursor.siguiente();
+            if (!r) {
+                return false;
+            }
+            preparar_coche(coche, id, direccion, gen, false);
+            coche.peso_toneladas = r->peso_toneladas;
+            coche.altura_metros = r->altura_metros;
+            coche.falla_mecanica_grave = r->falla != 0;
+            llegada_ms = cursor.relativo_ms(*r);
+        } else {
+            if (generados >= params.coches_por_lado) {
+                return false;
+            }
+            if (generados > 0) {
+                instante_ms += llegadas.siguiente_ms(gen);
+            }
+            preparar_coche(coche, id, direccion, gen, params.coches_defectuosos);
+            llegada_ms = llround(instante_ms);
+        }
 
-    void reanudar_sistema() {
-        unique_lock<mutex> lock(mtx);
-        puente_bloqueado = false;
-        sistema_en_pausa = false;
-        causa_bloqueo = "N/A"; 
-
-        sensor_izq_ok = true;
-        sensor_der_ok = true;
-        barrera_izq_ok = true;
-        barrera_der_ok = true;
-        
-        cola_izquierda.notify_all();
-        cola_derecha.notify_all();
+        coche.retardo_cola_ms = 0;
+        if (params.retardo_cola_max_ms > 0) {
+            coche.retardo_cola_ms = uniform_int_distribution<>(0, params.retardo_cola_max_ms - 1)(gen);
+        }
+        generados++;
+        return true;
     }
 };
 
-MonitorPuente monitor;
-
-void log_evento(const string& mensaje) {
-    if (monitor.sistema_en_pausa) {
-        return; 
+// Espera hasta el instante de llegada de un coche, escalado por la velocidad.
+void esperar_llegada(chrono::steady_clock::time_point inicio, int64_t llegada_ms) {
+    if (parametros.velocidad_llegadas > 0 && llegada_ms > 0) {
+        chrono::duration<double, milli> espera(llegada_ms / parametros.velocidad_llegadas);
+        this_thread::sleep_until(inicio + chrono::duration_cast<chrono::steady_clock::duration>(espera));
     }
-    cerr << "[" << get_timestamp() << "] " << mensaje << endl;
-}
-
-void MonitorPuente::llega_cola(Coche* coche) {
-    unique_lock<mutex> lock(mtx);
-    coches_esperando[coche->direccion]++;
-    log_evento("[SENSOR ENTRADA] Coche " + to_string(coche->id) + " detectado en cola " + direccion_str(coche->direccion) + " (esperando: " + to_string(coches_esperando[coche->direccion]) + ")");
 }
 
-void MonitorPuente::pasa_coche(Coche* coche) {
-    unique_lock<mutex> lock(mtx);
+void generador_coches(Direccion direccion) {
+    vector<thread> hilos_coches;
+    deque<Coche> coches;
+    
+    FuenteCoches fuente(parametros, direccion, parametros.semilla);
+    auto inicio = chrono::steady_clock::now();
+    int64_t llegada_ms;
     
-    Direccion mi_dir = coche->direccion;
-    Direccion otra_dir = (mi_dir == IZQUIERDA) ? DERECHA : IZQUIERDA;
-    condition_variable& mi_cola = (mi_dir == IZQUIERDA) ? cola_izquierda : cola_derecha;
+    log_evento("Generador de coches " + direccion_str(direccion) + " iniciado");
     
-    log_evento("[ESTADO BLOQUEADO] Coche " + to_string(coche->id) + " entra en cola " + direccion_str(mi_dir));
+    while (monitor.sistema_activo) {
+        coches.emplace_back();
+        if (!fuente.siguiente(coches.back(), llegada_ms)) {
+            coches.pop_back();
+            break;
+        }
+        esperar_llegada(inicio, llegada_ms);
 
-    mi_cola.wait(lock, [&] {
-        if (!monitor.sistema_activo) {
-             return true; 
+        hilos_coches.emplace_back(tarea_coche, &coches.back());
+        monitor.total_generados++;
+    }
+    
+    for (auto& hilo : hilos_coches) {
+        if (hilo.joinable()) {
+            hilo.join();
         }
-        
-        if (coche->estado == RECHAZADO) {
-             return true; 
+    }
+    
+    log_evento("Generador de coches " + direccion_str(direccion) + " finalizado");
+}
+
+// Ejecutor con un numero fijo de hilos. Cada coche es una maquina de estados
+// (ESPERANDO -> CRUZANDO -> FINALIZADO) que avanza un paso cada vez que un
+// trabajador lo toma; mientras espera turno queda aparcado en el monitor y
+// mientras cruza queda en la cola de temporizadores, sin ocupar ningun hilo.
+class EjecutorCoches {
+private:
+    struct Temporizador {
+        chrono::steady_clock::time_point vence;
+        uint64_t secuencia;
+        Coche* coche;
+
+        bool operator>(const Temporizador& otro) const {
+            if (vence != otro.vence) return vence > otro.vence;
+            return secuencia > otro.secuencia;
         }
-        
-        bool no_bloqueado = !puente_bloqueado;
-        
-        bool mi_sensor_ok = (mi_dir == IZQUIERDA) ? sensor_izq_ok : sensor_der_ok;
-        bool mi_barrera_ok = (mi_dir == IZQUIERDA) ? barrera_izq_ok : barrera_der_ok;
+    };
+
+    mutex mtx;
+    condition_variable cv_trabajo;
+    condition_variable cv_temporizador;
+    condition_variable cv_inactivo;
+    deque<Coche*> listos;
+    priority_queue<Temporizador, vector<Temporizador>, greater<Temporizador>> temporizadores;
+    uint64_t secuencia = 0;
+    int64_t pendientes = 0;
+    bool activo = true;
+
+    vector<thread> trabajadores;
+    thread hilo_temporizador;
 
-        if (!mi_sensor_ok || !mi_barrera_ok) {
-            return false; 
+    void bucle_trabajador() {
+        unique_lock<mutex> lock(mtx);
+        while (true) {
+            cv_trabajo.wait(lock, [&] { return !listos.empty() || !activo; });
+            if (listos.empty()) return;
+
+            Coche* coche = listos.front();
+            listos.pop_front();
+            lock.unlock();
+            paso_coche(coche);
+            lock.lock();
         }
+    }
 
-        bool es_mi_turno = (turno == mi_dir || turno == NINGUNO);
-        bool puente_libre = (coches_en_puente[otra_dir] == 0);
-        bool hay_capacidad = (coches_en_puente[mi_dir] < MAX_COCHES_SIMULTANEOS);
-        bool puede_pasar_seguido = true;
-        if (coches_esperando[otra_dir] > 0) {
-            puede_pasar_seguido = (coches_seguidos[mi_dir] < MAX_COCHES_SEGUIDOS);
+    void bucle_temporizador() {
+        unique_lock<mutex> lock(mtx);
+        while (activo) {
+            if (temporizadores.empty()) {
+                cv_temporizador.wait(lock);
+                continue;
+            }
+            auto vence = temporizadores.top().vence;
+            if (chrono::steady_clock::now() < vence) {
+                cv_temporizador.wait_until(lock, vence);
+                continue;
+            }
+            while (!temporizadores.empty() && temporizadores.top().vence <= chrono::steady_clock::now()) {
+                listos.push_back(temporizadores.top().coche);
+                temporizadores.pop();
+                cv_trabajo.notify_one();
+            }
         }
+    }
 
-        if (coche->peso_toneladas > MAX_PESO_TON || coche->altura_metros > MAX_ALTURA_M || coche->falla_mecanica_grave) {
-            
-            string razon;
-            if (coche->peso_toneladas > MAX_PESO_TON) razon = "Infracción de Peso (" + to_string(coche->peso_toneladas) + "T)";
-            else if (coche->altura_metros > MAX_ALTURA_M) razon = "Infracción de Altura (" + to_string(coche->altura_metros) + "m)";
-            else razon = "Falla Mecánica Grave (Accidente)";
+    void paso_coche(Coche* coche) {
+#if defined(__cpp_impl_coroutine)
+        if (coche->continuacion) {
+            coroutine_handle<>::from_address(coche->continuacion).resume();
+            return;
+        }
+#endif
+        switch (coche->estado) {
+            case ESPERANDO:
+                if (monitor.pasa_coche_o_aparcar(coche)) {
+                    continuar(coche);
+                }
+                break;
+            case CRUZANDO:
+                monitor.sale_coche(coche);
+                terminar();
+                break;
+            default:
+                terminar();
+                break;
+        }
+    }
 
-            log_evento("Coche " + to_string(coche->id) + " DETENIDO. Razón: " + razon);
-            
-            coche->estado = RECHAZADO;
-            coches_esperando[mi_dir]--; 
-            
-            if (!puente_bloqueado) {
-                puente_bloqueado = true; 
-                sistema_en_pausa = true; 
-                causa_bloqueo = razon; 
-                log_evento("Accidente/Infracción de vehículo (" + razon + ") fuerza la SUSPENSIÓN del sistema.");
-                
-                cola_izquierda.notify_all();
-                cola_derecha.notify_all();
-            }
-            
-            return true; 
+public:
+    EjecutorCoches(int num_hilos) {
+        for (int i = 0; i < num_hilos; i++) {
+            trabajadores.emplace_back(&EjecutorCoches::bucle_trabajador, this);
         }
+        hilo_temporizador = thread(&EjecutorCoches::bucle_temporizador, this);
+    }
 
-        return no_bloqueado && es_mi_turno && puente_libre && hay_capacidad && puede_pasar_seguido;
-    });
+    ~EjecutorCoches() {
+        {
+            lock_guard<mutex> lock(mtx);
+            activo = false;
+        }
+        cv_trabajo.notify_all();
+        cv_temporizador.notify_all();
+        for (auto& hilo : trabajadores) hilo.join();
+        hilo_temporizador.join();
+    }
 
-    if (coche->estado == RECHAZADO || sistema_en_pausa || !sistema_activo) {
-         return; 
+    void programar(Coche* coche, int retardo_ms) {
+        lock_guard<mutex> lock(mtx);
+        auto vence = chrono::steady_clock::now() + chrono::milliseconds(retardo_ms);
+        bool primero = temporizadores.empty() || vence < temporizadores.top().vence;
+        temporizadores.push(Temporizador{vence, secuencia++, coche});
+        if (primero) {
+            cv_temporizador.notify_one();
+        }
     }
 
-    log_evento("[TRANSICIÓN: LISTO -> EJECUCIÓN] Coche " + to_string(coche->id) + " obtiene permiso.");
+    void reanudar(Coche* coche) {
+        lock_guard<mutex> lock(mtx);
+        listos.push_back(coche);
+        cv_trabajo.notify_one();
+    }
 
-    if (turno == NINGUNO) {
-        turno = mi_dir;
+    void terminar() {
+        lock_guard<mutex> lock(mtx);
+        if (--pendientes == 0) {
+            cv_inactivo.notify_all();
+        }
     }
-    
-    coches_esperando[mi_dir]--; 
-    coches_en_puente[mi_dir]++;
-    
-    if (coches_esperando[otra_dir] > 0) {
-        coches_seguidos[mi_dir]++;
+
+    void nuevo_coche(Coche* coche, int retardo_ms) {
+        {
+            lock_guard<mutex> lock(mtx);
+            pendientes++;
+        }
+        programar(coche, retardo_ms);
     }
-    
-    coche->estado = CRUZANDO;
-    coche->tiempo_inicio_cruce = chrono::system_clock::now();
-    
-    log_evento("[BARRERA ABRE] Coche " + to_string(coche->id) + " ENTRA desde " + direccion_str(mi_dir) + 
-               " (en puente: " + to_string(coches_en_puente[mi_dir]) + ", seguidos: " + 
-               to_string(coches_seguidos[mi_dir]) + "/" + to_string(MAX_COCHES_SEGUIDOS) + ")");
-}
 
-void MonitorPuente::sale_coche(Coche* coche) {
-    unique_lock<mutex> lock(mtx);
-    
-    Direccion mi_dir = coche->direccion;
-    Direccion otra_dir = (mi_dir == IZQUIERDA) ? DERECHA : IZQUIERDA;
-    
-    if (coche->estado == CRUZANDO) {
-        coches_en_puente[mi_dir]--;
-        total_cruzados++;
-        coche->estado = FINALIZADO;
-        log_evento("[TRANSICIÓN: EJECUCIÓN -> TERMINADO] Coche " + to_string(coche->id) + " SALE");
-
-        if (coches_en_puente[mi_dir] == 0) {
-            if (coches_seguidos[mi_dir] >= MAX_COCHES_SEGUIDOS) {
-                coches_seguidos[mi_dir] = 0;
-            }
-            if (coches_esperando[otra_dir] > 0) {
-                turno = otra_dir;
-                log_evento("Cambio de turno a " + direccion_str(otra_dir));
-                (otra_dir == IZQUIERDA ? cola_izquierda : cola_derecha).notify_all();
-            } else {
-                turno = NINGUNO;
-                coches_seguidos[mi_dir] = 0;
-            }
+    // Un coche que acaba de resolver su paso por el monitor: si obtuvo permiso
+    // empieza a cruzar, si fue rechazado sale del sistema.
+    void continuar(Coche* coche) {
+        if (coche->estado == CRUZANDO) {
+            programar(coche, parametros.tiempo_cruce_ms);
         } else {
-            (mi_dir == IZQUIERDA ? cola_izquierda : cola_derecha).notify_one();
+            if (registro_habilitado && coche->estado == RECHAZADO) {
+                log_evento("Coche " + to_string(coche->id) + " RECHAZADO y desalojado.");
+            }
+            terminar();
         }
-    } 
-}
+    }
 
-void tarea_coche(Coche* coche) {
-    coche->tiempo_llegada = chrono::system_clock::now();
-    coche->estado = ESPERANDO;
-    
-    monitor.llega_cola(coche);
-    this_thread::sleep_for(chrono::milliseconds(rand() % 500));
+    void esperar_inactivo() {
+        unique_lock<mutex> lock(mtx);
+        cv_inactivo.wait(lock, [&] { return pendientes == 0; });
+    }
+};
+
+void generador_coches_pool(Direccion direccion, EjecutorCoches& ejecutor, deque<Coche>& coches) {
+    FuenteCoches fuente(parametros, direccion, parametros.semilla);
+    auto inicio = chrono::steady_clock::now();
+    int64_t llegada_ms;
     
-    monitor.pasa_coche(coche);
+    log_evento("Generador de coches " + direccion_str(direccion) + " iniciado (pool)");
     
-    if (!monitor.sistema_activo) {
-        return; 
+    while (monitor.sistema_activo) {
+        coches.emplace_back();
+        Coche* coche = &coches.back();
+        if (!fuente.siguiente(*coche, llegada_ms)) {
+            coches.pop_back();
+            break;
+        }
+        esperar_llegada(inicio, llegada_ms);
+
+        coche->tiempo_llegada = chrono::steady_clock::now();
+        monitor.llega_cola(coche);
+        monitor.total_generados++;
+
+        ejecutor.nuevo_coche(coche, coche->retardo_cola_ms);
     }
     
-    if (coche->estado == RECHAZADO) {
-        log_evento("Coche " + to_string(coche->id) + " RECHAZADO y desalojado. Finaliza hilo.");
-    } else if (coche->estado == CRUZANDO) {
-        this_thread::sleep_for(chrono::milliseconds(TIEMPO_CRUCE_MS));
-        monitor.sale_coche(coche);
-    } 
+    log_evento("Generador de coches " + direccion_str(direccion) + " finalizado (pool)");
 }
 
-void generador_coches(Direccion direccion) {
-    vector<thread> hilos_coches;
-    vector<Coche> coches(TOTAL_COCHES_POR_LADO); 
-    
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_int_distribution<> prob_problema(1, 5);
-    uniform_int_distribution<> peso_dist(10, 30);
-    uniform_int_distribution<> altura_dist(3, 6);
-    
-    log_evento("Generador de coches " + direccion_str(direccion) + " iniciado");
-    
-    for (int i = 0; i < TOTAL_COCHES_POR_LADO; i++) {
-        if (!monitor.sistema_activo) break;
-        
-        coches[i].id = (direccion * 100) + i + 1;
-        coches[i].direccion = direccion;
-        coches[i].estado = ESPERANDO;
-        
-        coches[i].peso_toneladas = peso_dist(gen);
-        coches[i].altura_metros = altura_dist(gen);
-        coches[i].falla_mecanica_grave = false;
+#if defined(__cpp_impl_coroutine)
+// Version con corrutinas de tarea_coche: el coche suspende su marco en lugar de
+// bloquear un hilo, tanto al esperar turno como al cruzar. El marco se reanuda
+// desde los trabajadores de EjecutorCoches.
+struct TareaCoche {
+    struct promise_type {
+        EjecutorCoches* ejecutor;
 
-        if (prob_problema(gen) == 1) { 
-            int tipo_problema = rand() % 3;
-            if (tipo_problema == 0) coches[i].peso_toneladas = MAX_PESO_TON + 1;
-            else if (tipo_problema == 1) coches[i].altura_metros = MAX_ALTURA_M + 1;
-            else coches[i].falla_mecanica_grave = true;
+        promise_type(Coche*, EjecutorCoches& e) : ejecutor(&e) {}
 
-            log_evento("Generando Coche " + to_string(coches[i].id) + " con FALSA CAPACIDAD.");
-        } else {
-            coches[i].peso_toneladas = peso_dist(gen) % (MAX_PESO_TON - 1) + 1;
-            coches[i].altura_metros = altura_dist(gen) % (MAX_ALTURA_M - 1) + 1;
-            coches[i].peso_toneladas = max(1, coches[i].peso_toneladas); 
-            coches[i].altura_metros = max(1, coches[i].altura_metros); 
+        TareaCoche get_return_object() {
+            return TareaCoche{coroutine_handle<promise_type>::from_promise(*this)};
         }
+        suspend_always initial_suspend() noexcept { return {}; }
+        suspend_never final_suspend() noexcept { return {}; }
+        void return_void() { ejecutor->terminar(); }
+        void unhandled_exception() { terminate(); }
+    };
 
-        hilos_coches.emplace_back(tarea_coche, &coches[i]);
-        monitor.total_generados++;
-        
-        this_thread::sleep_for(chrono::milliseconds(500 + rand() % 1500));
+    coroutine_handle<promise_type> handle;
+};
+
+struct EsperaTemporizador {
+    EjecutorCoches& ejecutor;
+    Coche* coche;
+    int retardo_ms;
+
+    bool await_ready() const noexcept { return retardo_ms <= 0; }
+    void await_suspend(coroutine_handle<> h) {
+        coche->continuacion = h.address();
+        ejecutor.programar(coche, retardo_ms);
+    }
+    void await_resume() const noexcept {}
+};
+
+// El coche queda aparcado en el monitor si no puede pasar; `despachador` lo
+// devuelve al ejecutor cuando el monitor le concede el paso.
+struct EsperaPaso {
+    MonitorPuente& puente;
+    Coche* coche;
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(coroutine_handle<> h) {
+        coche->continuacion = h.address();
+        return !puente.pasa_coche_o_aparcar(coche);
+    }
+    void await_resume() const noexcept {}
+};
+
+EsperaPaso pasa_coche_async(MonitorPuente& puente, Coche* coche) {
+    return EsperaPaso{puente, coche};
+}
+
+TareaCoche tarea_coche_corrutina(Coche* coche, EjecutorCoches& ejecutor) {
+    co_await EsperaTemporizador{ejecutor, coche, coche->retardo_cola_ms};
+
+    co_await pasa_coche_async(monitor, coche);
+
+    if (coche->estado == RECHAZADO) {
+        if (registro_habilitado) {
+            log_evento("Coche " + to_string(coche->id) + " RECHAZADO y desalojado.");
+        }
+        co_return;
     }
+
+    co_await EsperaTemporizador{ejecutor, coche, parametros.tiempo_cruce_ms};
+    monitor.sale_coche(coche);
+}
+
+void generador_coches_corrutinas(Direccion direccion, EjecutorCoches& ejecutor, deque<Coche>& coches) {
+    FuenteCoches fuente(parametros, direccion, parametros.semilla);
+    auto inicio = chrono::steady_clock::now();
+    int64_t llegada_ms;
     
-    for (auto& hilo : hilos_coches) {
-        if (hilo.joinable()) {
-            hilo.join();
+    log_evento("Generador de coches " + direccion_str(direccion) + " iniciado (corrutinas)");
+    
+    while (monitor.sistema_activo) {
+        coches.emplace_back();
+        Coche* coche = &coches.back();
+        if (!fuente.siguiente(*coche, llegada_ms)) {
+            coches.pop_back();
+            break;
         }
+        esperar_llegada(inicio, llegada_ms);
+
+        coche->tiempo_llegada = chrono::steady_clock::now();
+        monitor.llega_cola(coche);
+        monitor.total_generados++;
+
+        coche->continuacion = tarea_coche_corrutina(coche, ejecutor).handle.address();
+        ejecutor.nuevo_coche(coche, 0);
     }
     
-    log_evento("Generador de coches " + direccion_str(direccion) + " finalizado");
+    log_evento("Generador de coches " + direccion_str(direccion) + " finalizado (corrutinas)");
 }
+#endif
 
 void detector_fallas() {
-    random_device rd;
-    mt19937 gen(rd());
+    mt19937 gen = flujo_aleatorio(parametros.semilla, FLUJO_FALLAS);
     uniform_int_distribution<> sleep_dist(10, 20); 
     uniform_int_distribution<> fail_dist(1, 4); 
     
@@ -400,9 +540,6 @@ void detector_fallas() {
             log_evento("ALARMA! " + causa + " detectada.");
             log_evento("Sistema pausado. Se requiere intervención del Operario.");
             cout << "==============================================\n";
-            
-            monitor.cola_izquierda.notify_all();
-            monitor.cola_derecha.notify_all();
 
             this_thread::sleep_for(chrono::seconds(1)); 
         }
@@ -466,58 +603,1294 @@ void tarea_intervencion() {
             this_thread::sleep_for(chrono::milliseconds(100)); 
         }
     }
-    cerr << "[" << get_timestamp() << "] Hilo de Intervención finalizado." << endl;
+    cerr << "[" << hora_actual() << "] Hilo de Intervención finalizado." << endl;
 }
 
-int main() {
-    srand(time(NULL)); 
-    
-    cout << "\n";
-    cout << "============================================================\n";
-    cout << "         SISTEMA DE CONTROL DEL PUENTE DUERO                \n";
-    cout << "         Grupo no. 2 Sistemas Operativos I III PAC 2025     \n";
-    cout << "============================================================\n";
-    cout << "\n";
-    
-    thread generador_izq(generador_coches, IZQUIERDA);
-    thread generador_der(generador_coches, DERECHA);
-    thread monitor_thread(monitor_estado);
-    thread fallas_thread(detector_fallas);
-    thread intervencion_thread(tarea_intervencion); 
-    
-    intervencion_thread.detach(); 
-    
-    if (generador_izq.joinable()) generador_izq.join();
-    if (generador_der.joinable()) generador_der.join();
-    
-    if (monitor.sistema_en_pausa) {
-        cerr << "[" << get_timestamp() << "] Generadores terminados, esperando intervención para apagar..." << endl;
-        while (monitor.sistema_en_pausa) {
-            this_thread::sleep_for(chrono::milliseconds(200));
+// Simulacion por eventos discretos: las mismas reglas del monitor, pero el
+// tiempo es un reloj virtual que avanza de evento en evento en lugar de sleep_for.
+enum TipoEvento { EV_LLEGADA, EV_SOLICITUD, EV_SALIDA, EV_FALLA, EV_INTERVENCION };
+
+struct Evento {
+    int64_t tiempo_ms;
+    uint64_t secuencia;
+    TipoEvento tipo;
+    Direccion direccion;
+    Coche* coche;
+
+    bool operator>(const Evento& otro) const {
+        if (tiempo_ms != otro.tiempo_ms) return tiempo_ms > otro.tiempo_ms;
+        return secuencia > otro.secuencia;
+    }
+};
+
+// Puente: el monitor con la politica que se quiera simular.
+template <class Puente = MonitorPuente>
+class SimuladorEventos {
+private:
+    Puente& puente;
+    ParametrosSimulacion params;
+
+    priority_queue<Evento, vector<Evento>, greater<Evento>> eventos;
+    deque<Coche> almacen;
+    vector<Coche*> libres;
+
+    mt19937 gen;
+    FuenteCoches fuentes[2];
+    uniform_int_distribution<> falla_espera_dist{10, 20};
+    uniform_int_distribution<> falla_dist{1, 4};
+
+    int64_t ahora_ms = 0;
+    uint64_t secuencia = 0;
+    bool fuente_agotada[2] = {false, false};
+    int64_t coches_activos = 0;
+    bool intervencion_pendiente = false;
+    chrono::steady_clock::time_point origen;
+
+public:
+    uint64_t eventos_procesados = 0;
+
+    SimuladorEventos(Puente& p, const ParametrosSimulacion& parametros_sim, uint64_t semilla)
+        : puente(p), params(parametros_sim), gen(flujo_aleatorio(semilla, FLUJO_FALLAS)),
+          fuentes{FuenteCoches(params, IZQUIERDA, semilla), FuenteCoches(params, DERECHA, semilla)},
+          origen(chrono::steady_clock::now()) {
+        puente.despachador = [this](Coche* coche) { resolver_solicitud(coche); };
+        puente.reloj_traza = [this] { return ahora_ms * 1000; };
+    }
+
+    ~SimuladorEventos() {
+        puente.despachador = nullptr;
+        puente.reloj_traza = nullptr;
+    }
+
+    int64_t tiempo_simulado_ms() const { return ahora_ms; }
+
+    void programar(int64_t tiempo_ms, TipoEvento tipo, Direccion dir, Coche* coche) {
+        eventos.push(Evento{tiempo_ms, secuencia++, tipo, dir, coche});
+    }
+
+    chrono::steady_clock::time_point instante() const {
+        return origen + chrono::milliseconds(ahora_ms);
+    }
+
+    // Saca de la fuente el siguiente coche del sentido y programa su llegada.
+    void programar_llegada(Direccion direccion) {
+        Coche* coche;
+        if (!libres.empty()) {
+            coche = libres.back();
+            libres.pop_back();
+        } else {
+            almacen.emplace_back();
+            coche = &almacen.back();
+        }
+        int64_t llegada_ms;
+        if (!fuentes[direccion].siguiente(*coche, llegada_ms)) {
+            libres.push_back(coche);
+            fuente_agotada[direccion] = true;
+            return;
         }
-        cerr << "[" << get_timestamp() << "] Intervención completada. Procediendo al apagado final." << endl;
+        programar(max(llegada_ms, ahora_ms), EV_LLEGADA, direccion, coche);
     }
-    
-    monitor.sistema_activo = false; 
 
-    monitor.cola_izquierda.notify_all();
-    monitor.cola_derecha.notify_all();
-    monitor.cv_apagado.notify_all(); 
+    void liberar_coche(Coche* coche) {
+        libres.push_back(coche);
+        coches_activos--;
+    }
 
-    if (monitor_thread.joinable()) monitor_thread.join();
-    if (fallas_thread.joinable()) fallas_thread.join();
-    
-    cout << "\n";
-    cout << "============================================================\n";
-    cout << "                    ESTADÍSTICAS FINALES                    \n";
-    cout << "------------------------------------------------------------\n";
-    cout << "Total coches generados:          " << monitor.total_generados << "\n";
-    cout << "Total coches cruzados:           " << monitor.total_cruzados << "\n";
-    cout << "Coches retenidos/desalojados:    " << monitor.total_generados - monitor.total_cruzados << "\n";
-    cout << "============================================================\n";
-    cout << "\n";
+    void revisar_pausa() {
+        if (puente.sistema_en_pausa && !intervencion_pendiente) {
+            intervencion_pendiente = true;
+            programar(ahora_ms + TIEMPO_INTERVENCION_MS, EV_INTERVENCION, NINGUNO, nullptr);
+        }
+    }
+
+    // Llamado cuando el monitor resuelve la solicitud de un coche, ya sea en el
+    // momento o mas tarde al despachar los aparcados.
+    void resolver_solicitud(Coche* coche) {
+        if (coche->estado == RECHAZADO) {
+            liberar_coche(coche);
+            revisar_pausa();
+        } else {
+            coche->tiempo_inicio_cruce = instante();
+            programar(ahora_ms + params.tiempo_cruce_ms, EV_SALIDA, coche->direccion, coche);
+        }
+    }
+
+    void procesar(const Evento& ev) {
+        switch (ev.tipo) {
+            case EV_LLEGADA: {
+                Coche* coche = ev.coche;
+                coches_activos++;
+                puente.total_generados++;
+
+                coche->tiempo_llegada = instante();
+                puente.llega_cola(coche);
+                programar(ahora_ms + coche->retardo_cola_ms, EV_SOLICITUD, ev.direccion, coche);
+
+                programar_llegada(ev.direccion);
+                break;
+            }
+            case EV_SOLICITUD: {
+                if (puente.pasa_coche_o_aparcar(ev.coche)) {
+                    resolver_solicitud(ev.coche);
+                }
+                break;
+            }
+            case EV_SALIDA: {
+                puente.sale_coche(ev.coche, instante());
+                liberar_coche(ev.coche);
+                break;
+            }
+            case EV_FALLA: {
+                if (falla_dist(gen) == 1 && !puente.is_puente_bloqueado()) {
+                    puente.iniciar_bloqueo_puente("Falla de Componente (Sensor/Barrera)");
+                    puente.sistema_en_pausa = true;
+                    revisar_pausa();
+                }
+                if (quedan_coches()) {
+                    programar(ahora_ms + falla_espera_dist(gen) * 1000, EV_FALLA, NINGUNO, nullptr);
+                }
+                break;
+            }
+            case EV_INTERVENCION: {
+                intervencion_pendiente = false;
+                puente.reanudar_sistema();
+                break;
+            }
+        }
+    }
+
+    bool quedan_coches() const {
+        return coches_activos > 0 || !fuente_agotada[IZQUIERDA] || !fuente_agotada[DERECHA];
+    }
+
+    void ejecutar() {
+        programar_llegada(IZQUIERDA);
+        programar_llegada(DERECHA);
+        programar(falla_espera_dist(gen) * 1000, EV_FALLA, NINGUNO, nullptr);
+
+        while (!eventos.empty()) {
+            Evento ev = eventos.top();
+            eventos.pop();
+            ahora_ms = ev.tiempo_ms;
+            procesar(ev);
+            eventos_procesados++;
+        }
+    }
+};
+
+void mostrar_latencia(const string& nombre, const Histograma& h) {
+    cout << left << setw(18) << nombre << right << fixed << setprecision(1);
+    double percentiles[3] = {50, 90, 99};
+    for (double p : percentiles) {
+        cout << setw(12) << h.percentil(p) / 1000.0;
+    }
+    cout << setw(12) << h.maximo() / 1000.0 << "\n";
+}
+
+void mostrar_estadisticas_finales() {
+    cout << "\n";
+    cout << "============================================================\n";
+    cout << "                    ESTADÍSTICAS FINALES                    \n";
+    cout << "------------------------------------------------------------\n";
+    cout << "Total coches generados:          " << monitor.total_generados << "\n";
+    cout << "Total coches cruzados:           " << monitor.total_cruzados << "\n";
+    cout << "Coches retenidos/desalojados:    " << monitor.total_generados - monitor.total_cruzados << "\n";
+    cout << "------------------------------------------------------------\n";
+    cout << "Latencias (ms)             p50         p90         p99         máx\n";
+    for (int d = 0; d < 2; d++) {
+        mostrar_latencia("Espera " + direccion_str((Direccion)d), monitor.latencia_espera[d].instantanea());
+    }
+    for (int d = 0; d < 2; d++) {
+        mostrar_latencia("Cruce " + direccion_str((Direccion)d), monitor.latencia_cruce[d].instantanea());
+    }
+    cout << "============================================================\n";
+    cout << "\n";
+}
+
+// Texto de /metrics. Solo lee atomicos (la palabra de estado, los contadores
+// fragmentados y los histogramas concurrentes): un scrape nunca toma mtx ni
+// retrasa una admision.
+string metricas_prometheus(const MonitorPuente& m) {
+    static const char* sentidos[2] = {"izquierda", "derecha"};
+    static const char* motivos[3] = {"peso", "altura", "falla"};
+    static const double limites_s[] = {0.001, 0.005, 0.01, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 300};
+    const int num_limites = sizeof(limites_s) / sizeof(limites_s[0]);
+
+    EstadoPuente e = m.leer_estado();
+    TextoPrometheus t;
+
+    t.cabecera("puente_llegadas_total", "counter", "Coches que han llegado a la cola de cada sentido.");
+    for (int d = 0; d < 2; d++) {
+        t.muestra("puente_llegadas_total", string("sentido=\"") + sentidos[d] + "\"", m.metricas.total(MonitorPuente::MET_LLEGADAS + d));
+    }
+    t.cabecera("puente_cruces_total", "counter", "Coches que han cruzado el puente.");
+    for (int d = 0; d < 2; d++) {
+        t.muestra("puente_cruces_total", string("sentido=\"") + sentidos[d] + "\"", m.metricas.total(MonitorPuente::MET_CRUCES + d));
+    }
+    t.cabecera("puente_rechazos_total", "counter", "Coches detenidos en la entrada.");
+    for (int r = 0; r < 3; r++) {
+        t.muestra("puente_rechazos_total", string("motivo=\"") + motivos[r] + "\"", m.metricas.total(MonitorPuente::MET_RECHAZOS + r));
+    }
+    t.cabecera("puente_cambios_turno_total", "counter", "Cambios de turno por coches esperando en el otro sentido.");
+    t.muestra("puente_cambios_turno_total", "", m.metricas.total(MonitorPuente::MET_CAMBIOS_TURNO));
+    t.cabecera("puente_bloqueos_total", "counter", "Veces que el puente se ha bloqueado.");
+    t.muestra("puente_bloqueos_total", "", m.metricas.total(MonitorPuente::MET_BLOQUEOS));
+
+    int64_t inicio_bloqueo = m.inicio_bloqueo_ns.load();
+    uint64_t ns_bloqueado = m.ns_bloqueado.load();
+    if (inicio_bloqueo != 0) ns_bloqueado += reloj_monotonico_ns() - inicio_bloqueo;
+    t.cabecera("puente_bloqueo_segundos_total", "counter", "Tiempo total con el puente bloqueado, incluido el bloqueo en curso.");
+    t.muestra("puente_bloqueo_segundos_total", "", ns_bloqueado / 1e9);
+
+    t.cabecera("puente_cola", "gauge", "Coches esperando en cada sentido.");
+    for (int d = 0; d < 2; d++) {
+        t.muestra("puente_cola", string("sentido=\"") + sentidos[d] + "\"", e.esperando[d]);
+    }
+    t.cabecera("puente_ocupacion", "gauge", "Coches cruzando en cada sentido.");
+    for (int d = 0; d < 2; d++) {
+        t.muestra("puente_ocupacion", string("sentido=\"") + sentidos[d] + "\"", e.en_puente[d]);
+    }
+    t.cabecera("puente_seguidos", "gauge", "Coches seguidos del sentido en la racha actual.");
+    for (int d = 0; d < 2; d++) {
+        t.muestra("puente_seguidos", string("sentido=\"") + sentidos[d] + "\"", e.seguidos[d]);
+    }
+    t.cabecera("puente_turno", "gauge", "1 para el sentido que tiene el turno.");
+    for (int d = 0; d < 2; d++) {
+        t.muestra("puente_turno", string("sentido=\"") + sentidos[d] + "\"", e.turno == d ? 1 : 0);
+    }
+    t.cabecera("puente_bloqueado", "gauge", "1 si el puente esta bloqueado.");
+    t.muestra("puente_bloqueado", "", e.bloqueado ? 1 : 0);
+
+    t.cabecera("puente_espera_segundos", "histogram", "Espera en cola de los coches que cruzaron (llegada a inicio de cruce).");
+    for (int d = 0; d < 2; d++) {
+        t.histograma("puente_espera_segundos", string("sentido=\"") + sentidos[d] + "\"", m.latencia_espera[d].instantanea(), limites_s, num_limites, 1e-6);
+    }
+    t.cabecera("puente_cruce_segundos", "histogram", "Duracion del cruce.");
+    for (int d = 0; d < 2; d++) {
+        t.histograma("puente_cruce_segundos", string("sentido=\"") + sentidos[d] + "\"", m.latencia_cruce[d].instantanea(), limites_s, num_limites, 1e-6);
+    }
+    return t.str();
+}
+
+int ejecutar_simulacion_eventos(int coches_por_lado, bool verboso) {
+    registro_habilitado = verboso;
+
+    parametros.coches_por_lado = coches_por_lado;
+    SimuladorEventos simulador(monitor, parametros, parametros.semilla);
+
+    auto inicio = chrono::steady_clock::now();
+    simulador.ejecutar();
+    double segundos = chrono::duration<double>(chrono::steady_clock::now() - inicio).count();
+
+    mostrar_estadisticas_finales();
+
+    int64_t simulado_s = simulador.tiempo_simulado_ms() / 1000;
+    cout << "Tiempo simulado:                 " << simulado_s / 3600 << "h " << (simulado_s / 60) % 60 << "m " << simulado_s % 60 << "s\n";
+    cout << "Tiempo real:                     " << fixed << setprecision(3) << segundos << " s\n";
+    cout << "Eventos procesados:              " << simulador.eventos_procesados << "\n";
+    cout << "Semilla / llegadas:              " << parametros.semilla << " / " << (parametros.llegadas_grabadas ? "fichero" : nombre_llegadas(parametros.carga.tipo)) << "\n";
+    cout << "Llegadas por segundo (real):     " << setprecision(0) << monitor.total_generados / max(segundos, 1e-9) << "\n";
+    cout << "\n";
+
+    monitor.sistema_activo = false;
+    return 0;
+}
+
+// Un puente del corredor con su propio simulador de eventos (y por tanto sus
+// propios generadores). Cada tramo se reserva por separado, alineado a linea
+// de cache, y solo lo toca el hilo que lo ejecuta.
+struct alignas(64) TramoCorredor {
+    MonitorPuente puente;
+    SimuladorEventos<> simulador;
+
+    TramoCorredor(const ParametrosSimulacion& params, const LimitesPuente& limites, uint64_t semilla)
+        : puente(limites), simulador(puente, params, semilla) {}
+};
+
+struct alignas(64) ResultadoHiloCorredor {
+    int64_t generados = 0;
+    int64_t cruzados = 0;
+    uint64_t eventos = 0;
+};
+
+struct ResultadoCorredor {
+    int64_t generados = 0;
+    int64_t cruzados = 0;
+    uint64_t eventos = 0;
+    double segundos = 0;
+};
+
+// Simula `num_puentes` puentes independientes repartidos en bloques contiguos
+// entre `num_hilos` hilos. Cada hilo construye sus tramos (quedan en memoria
+// local a ese hilo) y acumula sus totales en su propia ranura de resultados.
+ResultadoCorredor ejecutar_corredor(int num_puentes, int num_hilos, int coches_por_lado, uint64_t semilla) {
+    num_hilos = max(1, min(num_hilos, num_puentes));
+    ParametrosSimulacion params = parametros;
+    params.coches_por_lado = coches_por_lado;
+    vector<ResultadoHiloCorredor> resultados(num_hilos);
+    vector<thread> hilos;
+
+    auto inicio = chrono::steady_clock::now();
+    for (int h = 0; h < num_hilos; h++) {
+        hilos.emplace_back([&, h] {
+            int desde = (int)((int64_t)num_puentes * h / num_hilos);
+            int hasta = (int)((int64_t)num_puentes * (h + 1) / num_hilos);
+            ResultadoHiloCorredor local;
+            for (int i = desde; i < hasta; i++) {
+                unique_ptr<TramoCorredor> tramo = make_unique<TramoCorredor>(params, LimitesPuente(), semilla + i);
+                tramo->simulador.ejecutar();
+                local.generados += tramo->puente.total_generados;
+                local.cruzados += tramo->puente.total_cruzados;
+                local.eventos += tramo->simulador.eventos_procesados;
+            }
+            resultados[h] = local;
+        });
+    }
+    for (thread& t : hilos) t.join();
+
+    ResultadoCorredor total;
+    total.segundos = chrono::duration<double>(chrono::steady_clock::now() - inicio).count();
+    for (const ResultadoHiloCorredor& r : resultados) {
+        total.generados += r.generados;
+        total.cruzados += r.cruzados;
+        total.eventos += r.eventos;
+    }
+    return total;
+}
+
+int ejecutar_simulacion_corredor(int num_puentes, int num_hilos, int coches_por_lado) {
+    registro_habilitado = false;
+    parametros.coches_por_lado = coches_por_lado;
+
+    ResultadoCorredor r = ejecutar_corredor(num_puentes, num_hilos, coches_por_lado, parametros.semilla);
+
+    cout << "\n";
+    cout << "============================================================\n";
+    cout << "                 CORREDOR DE " << num_puentes << " PUENTES\n";
+    cout << "------------------------------------------------------------\n";
+    cout << "Hilos:                           " << max(1, min(num_hilos, num_puentes)) << "\n";
+    cout << "Total coches generados:          " << r.generados << "\n";
+    cout << "Total coches cruzados:           " << r.cruzados << "\n";
+    cout << "Eventos procesados:              " << r.eventos << "\n";
+    cout << "Tiempo real:                     " << fixed << setprecision(3) << r.segundos << " s\n";
+    cout << "Coches por segundo (real):       " << setprecision(0) << r.generados / max(r.segundos, 1e-9) << "\n";
+    cout << "============================================================\n";
+    cout << "\n";
+    return 0;
+}
+
+// Tabla de coches/s segun numero de puentes e hilos. Cada puente simula la
+// misma carga, asi que con hilos suficientes el total deberia crecer casi
+// linealmente con el numero de nucleos.
+int ejecutar_benchmark_corredor(int coches_por_lado, int max_hilos) {
+    registro_habilitado = false;
+    parametros.coches_por_lado = coches_por_lado;
+
+    cout << "\nBenchmark del corredor: " << 2 * coches_por_lado << " coches por puente, hasta "
+         << max_hilos << " hilos (" << thread::hardware_concurrency() << " núcleos)\n\n";
+    cout << setw(8) << "Puentes" << setw(8) << "Hilos" << setw(12) << "Tiempo (s)"
+         << setw(16) << "Coches/s" << setw(13) << "Aceleración" << "\n";
+
+    for (int puentes = 1; puentes <= 4 * max_hilos; puentes *= 2) {
+        double base = 0;
+        // Potencias de dos y, si no lo es, tambien el maximo (6 o 12 nucleos).
+        int limite = min(puentes, max_hilos);
+        for (int hilos = 1; hilos <= limite; hilos = (hilos == limite) ? hilos + 1 : min(2 * hilos, limite)) {
+            ResultadoCorredor r = ejecutar_corredor(puentes, hilos, coches_por_lado, 12345);
+            double coches_s = r.generados / max(r.segundos, 1e-9);
+            if (hilos == 1) base = coches_s;
+            cout << setw(8) << puentes << setw(8) << hilos << setw(12) << fixed << setprecision(3) << r.segundos
+                 << setw(16) << setprecision(0) << coches_s << setw(11) << setprecision(2) << coches_s / base << "x\n";
+        }
+    }
+    cout << "\n";
+    return 0;
+}
+
+// Rango inclusivo "desde:hasta:paso" de un parametro del barrido.
+struct RangoBarrido {
+    int desde;
+    int hasta;
+    int paso = 1;
+
+    vector<int> valores() const {
+        vector<int> v;
+        for (int x = desde; x <= hasta; x += max(1, paso)) v.push_back(x);
+        return v;
+    }
+};
+
+bool leer_rango(const string& texto, RangoBarrido& rango) {
+    int leidos = sscanf(texto.c_str(), "%d:%d:%d", &rango.desde, &rango.hasta, &rango.paso);
+    if (leidos < 1) return false;
+    if (leidos == 1) rango.hasta = rango.desde;
+    return rango.hasta >= rango.desde;
+}
+
+struct ConfiguracionBarrido {
+    LimitesPuente limites;
+    ParametrosSimulacion params;
+};
+
+struct FilaBarrido {
+    ConfiguracionBarrido config;
+    int64_t generados = 0;
+    int64_t cruzados = 0;
+    int cambios_turno = 0;
+    int64_t simulado_ms = 0;
+    Histograma espera[2];
+};
+
+// Ejecuta cada combinacion como una simulacion de eventos independiente, con
+// la misma semilla para todas (numeros aleatorios comunes), repartidas entre
+// `num_hilos` hilos que toman la siguiente combinacion libre.
+int ejecutar_barrido(int argc, char* argv[]) {
+    registro_habilitado = false;
+
+    RangoBarrido simultaneos{MAX_COCHES_SIMULTANEOS, MAX_COCHES_SIMULTANEOS};
+    RangoBarrido seguidos{1, 10};
+    RangoBarrido coches{2000, 2000};
+    RangoBarrido cruce{TIEMPO_CRUCE_MS, TIEMPO_CRUCE_MS};
+    RangoBarrido peso{MAX_PESO_TON, MAX_PESO_TON};
+    RangoBarrido altura{MAX_ALTURA_M, MAX_ALTURA_M};
+    int num_hilos = (int)max(1u, thread::hardware_concurrency());
+
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        size_t igual = arg.find('=');
+        string clave = arg.substr(0, igual);
+        string valor = (igual == string::npos) ? "" : arg.substr(igual + 1);
+        RangoBarrido* rango = nullptr;
+        if (clave == "simultaneos") rango = &simultaneos;
+        else if (clave == "seguidos") rango = &seguidos;
+        else if (clave == "coches") rango = &coches;
+        else if (clave == "cruce") rango = &cruce;
+        else if (clave == "peso") rango = &peso;
+        else if (clave == "altura") rango = &altura;
+        else if (clave == "hilos") {
+            num_hilos = max(1, atoi(valor.c_str()));
+            continue;
+        }
+        if (!rango || !leer_rango(valor, *rango)) {
+            cerr << "Argumento no válido: " << arg << endl;
+            cerr << "Uso: --barrido [simultaneos=A:B[:P]] [seguidos=..] [coches=..] [cruce=..] [peso=..] [altura=..] [hilos=N]" << endl;
+            return 1;
+        }
+    }
+
+    int maximo = (int)EstadoPuente::MASCARA_PUENTE;
+    if (simultaneos.desde < 1 || simultaneos.hasta > maximo || seguidos.desde < 1 || seguidos.hasta > maximo) {
+        cerr << "simultaneos y seguidos deben estar entre 1 y " << maximo << endl;
+        return 1;
+    }
+
+    vector<FilaBarrido> filas;
+    for (int sim : simultaneos.valores())
+    for (int seg : seguidos.valores())
+    for (int n : coches.valores())
+    for (int c : cruce.valores())
+    for (int pe : peso.valores())
+    for (int al : altura.valores()) {
+        FilaBarrido fila;
+        fila.config.params = parametros;
+        fila.config.params.coches_por_lado = n;
+        fila.config.params.tiempo_cruce_ms = c;
+        fila.config.limites.max_simultaneos = sim;
+        fila.config.limites.max_seguidos = seg;
+        fila.config.limites.max_peso_ton = pe;
+        fila.config.limites.max_altura_m = al;
+        filas.push_back(fila);
+    }
+
+    cout << "\nBarrido de parámetros: " << filas.size() << " combinaciones en " << num_hilos << " hilos\n\n";
+
+    atomic<size_t> siguiente{0};
+    vector<thread> hilos;
+    auto inicio = chrono::steady_clock::now();
+    for (int h = 0; h < num_hilos; h++) {
+        hilos.emplace_back([&] {
+            size_t i;
+            while ((i = siguiente++) < filas.size()) {
+                FilaBarrido& fila = filas[i];
+                unique_ptr<MonitorPuente> puente = make_unique<MonitorPuente>(fila.config.limites);
+                SimuladorEventos simulador(*puente, fila.config.params, 12345);
+                simulador.ejecutar();
+                fila.generados = puente->total_generados;
+                fila.cruzados = puente->total_cruzados;
+                fila.cambios_turno = puente->cambios_turno;
+                fila.simulado_ms = simulador.tiempo_simulado_ms();
+                for (int d = 0; d < 2; d++) {
+                    fila.espera[d] = puente->latencia_espera[d].instantanea();
+                }
+            }
+        });
+    }
+    for (thread& t : hilos) t.join();
+    double segundos = chrono::duration<double>(chrono::steady_clock::now() - inicio).count();
+
+    cout << setw(5) << "Sim" << setw(5) << "Seg" << setw(8) << "Coches" << setw(7) << "Cruce"
+         << setw(6) << "Peso" << setw(5) << "Alt" << setw(10) << "Coches/h"
+         << setw(11) << "Media IZQ" << setw(11) << "Media DER" << setw(11) << "p99 IZQ" << setw(11) << "p99 DER"
+         << setw(8) << "Turnos" << setw(9) << "Rechaz." << "\n";
+    for (const FilaBarrido& f : filas) {
+        double horas = max(f.simulado_ms, (int64_t)1) / 3600000.0;
+        cout << setw(5) << f.config.limites.max_simultaneos << setw(5) << f.config.limites.max_seguidos
+             << setw(8) << f.config.params.coches_por_lado << setw(7) << f.config.params.tiempo_cruce_ms
+             << setw(6) << f.config.limites.max_peso_ton << setw(5) << f.config.limites.max_altura_m
+             << setw(10) << fixed << setprecision(0) << f.cruzados / horas << setprecision(1);
+        for (int d = 0; d < 2; d++) cout << setw(11) << f.espera[d].media() / 1e6;
+        for (int d = 0; d < 2; d++) cout << setw(11) << f.espera[d].percentil(99) / 1e6;
+        cout << setw(8) << f.cambios_turno << setw(9) << f.generados - f.cruzados << "\n";
+    }
+    cout << "\nEsperas en segundos de tiempo simulado. Tiempo real: " << setprecision(3) << segundos << " s\n\n";
+    return 0;
+}
+
+enum ModoEjecucion { MODO_HILOS, MODO_POOL, MODO_CORRUTINAS };
+
+// Arranca los dos generadores en el modo pedido. En los modos con ejecutor los
+// coches viven en `coches` y el monitor devuelve los aparcados al ejecutor.
+void iniciar_generadores(ModoEjecucion modo, EjecutorCoches* ejecutor, deque<Coche> coches[2], thread generadores[2]) {
+    Direccion dirs[2] = {IZQUIERDA, DERECHA};
+    switch (modo) {
+        case MODO_POOL:
+            monitor.despachador = [ejecutor](Coche* coche) { ejecutor->continuar(coche); };
+            for (Direccion dir : dirs) {
+                generadores[dir] = thread(generador_coches_pool, dir, ref(*ejecutor), ref(coches[dir]));
+            }
+            break;
+#if defined(__cpp_impl_coroutine)
+        case MODO_CORRUTINAS:
+            monitor.despachador = [ejecutor](Coche* coche) { ejecutor->reanudar(coche); };
+            for (Direccion dir : dirs) {
+                generadores[dir] = thread(generador_coches_corrutinas, dir, ref(*ejecutor), ref(coches[dir]));
+            }
+            break;
+#endif
+        default:
+            for (Direccion dir : dirs) {
+                generadores[dir] = thread(generador_coches, dir);
+            }
+            break;
+    }
+}
+
+void ejecutar_modo(ModoEjecucion modo, int num_hilos) {
+    deque<Coche> coches[2];
+    thread generadores[2];
+    unique_ptr<EjecutorCoches> ejecutor;
+    if (modo != MODO_HILOS) {
+        ejecutor = make_unique<EjecutorCoches>(num_hilos);
+    }
+
+    iniciar_generadores(modo, ejecutor.get(), coches, generadores);
+    generadores[IZQUIERDA].join();
+    generadores[DERECHA].join();
+    if (ejecutor) ejecutor->esperar_inactivo();
+}
+
+// Ejecuta un modo en un proceso hijo para medir su RSS maximo y sus cambios de
+// contexto sin mezclarlos con los del otro modo.
+void medir_modo(const string& nombre, ModoEjecucion modo, int num_hilos) {
+    auto inicio = chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("Error al hacer fork");
+        return;
+    }
+    if (pid == 0) {
+        ejecutar_modo(modo, num_hilos);
+        _exit(monitor.total_cruzados == 2 * parametros.coches_por_lado ? 0 : 1);
+    }
+
+    int status;
+    struct rusage uso;
+    wait4(pid, &status, 0, &uso);
+    double segundos = chrono::duration<double>(chrono::steady_clock::now() - inicio).count();
+    double coches = 2.0 * parametros.coches_por_lado;
+    long cambios = uso.ru_nvcsw + uso.ru_nivcsw;
+
+    cout << nombre << "\n";
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        cout << "  Ejecución fallida (estado " << status << ")\n";
+    }
+    cout << "  Tiempo:                     " << fixed << setprecision(3) << segundos << " s\n";
+    cout << "  RSS máximo:                 " << uso.ru_maxrss << " KB (" << setprecision(2) << uso.ru_maxrss / coches << " KB/coche)\n";
+    cout << "  Cambios de contexto:        " << cambios << " (" << cambios / coches << "/coche)\n";
+}
+
+int ejecutar_benchmark_pool(int coches_por_lado, int num_hilos, int tiempo_cruce_ms) {
+    registro_habilitado = false;
+    parametros.coches_por_lado = coches_por_lado;
+    parametros.tiempo_cruce_ms = tiempo_cruce_ms;
+    parametros.retardo_cola_max_ms = 0;
+    parametros.llegada_min_ms = 0;
+    parametros.llegada_rango_ms = 0;
+    parametros.coches_defectuosos = false;
+
+    cout << "\nBenchmark: " << 2 * coches_por_lado << " coches, cruce de " << tiempo_cruce_ms << " ms\n\n";
+    medir_modo("Un hilo por coche", MODO_HILOS, 0);
+    medir_modo("Pool de " + to_string(num_hilos) + " hilos", MODO_POOL, num_hilos);
+#if defined(__cpp_impl_coroutine)
+    medir_modo("Corrutinas sobre " + to_string(num_hilos) + " hilos", MODO_CORRUTINAS, num_hilos);
+#endif
+    cout << "\n";
+    return 0;
+}
+
+// Ejecuta el modo de un hilo por coche en un proceso hijo y muestra el tiempo
+// y el uso del mutex del monitor. La salida de registro va a /dev/null para
+// medir solo el coste en el monitor.
+void medir_mutex_hilos(const string& nombre, bool asincrono) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("Error al hacer fork");
+        return;
+    }
+    if (pid == 0) {
+        int nulo = open("/dev/null", O_WRONLY);
+        dup2(nulo, STDERR_FILENO);
+        close(nulo);
+
+        unique_ptr<RegistroAsincrono<RegistroMonitor>> registro;
+        if (asincrono) {
+            registro = make_unique<RegistroAsincrono<RegistroMonitor>>(formatear_registro, STDERR_FILENO);
+            fijar_registro_eventos(registro.get());
+        }
+        monitor.medir_mutex = true;
+
+        auto inicio = chrono::steady_clock::now();
+        ejecutar_modo(MODO_HILOS, 0);
+        double segundos = chrono::duration<double>(chrono::steady_clock::now() - inicio).count();
+        if (registro) registro->vaciar();
+
+        uint64_t tomas = monitor.tomas_mutex;
+        double ms_mutex = monitor.ns_mutex / 1e6;
+        cout << nombre << "\n";
+        cout << "  Tiempo:                     " << fixed << setprecision(3) << segundos << " s\n";
+        cout << "  Coches por segundo:         " << setprecision(0) << monitor.total_cruzados / max(segundos, 1e-9) << "\n";
+        cout << "  Tomas del mutex:            " << tomas << "\n";
+        cout << "  CAS de admisión por coche:  " << setprecision(3) << (double)monitor.cas_admision / max(1, monitor.total_cruzados.load()) << "\n";
+        cout << "  Tiempo con mutex tomado:    " << setprecision(3) << ms_mutex << " ms (" << setprecision(2) << (tomas ? monitor.ns_mutex / 1000.0 / tomas : 0.0) << " us/toma)\n";
+        if (registro) {
+            cout << "  Registros descartados:      " << registro->perdidos_total() << "\n";
+        }
+        cout << flush;
+        _exit(monitor.total_cruzados == 2 * parametros.coches_por_lado ? 0 : 1);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        cout << "  Ejecución fallida (estado " << status << ")\n";
+    }
+}
+
+int ejecutar_benchmark_registro(int coches_por_lado, int tiempo_cruce_ms) {
+    registro_habilitado = true;
+    parametros.coches_por_lado = coches_por_lado;
+    parametros.tiempo_cruce_ms = tiempo_cruce_ms;
+    parametros.retardo_cola_max_ms = 0;
+    parametros.llegada_min_ms = 0;
+    parametros.llegada_rango_ms = 0;
+    parametros.coches_defectuosos = false;
+
+    cout << "\nBenchmark de registro: " << 2 * coches_por_lado << " coches, cruce de " << tiempo_cruce_ms << " ms\n\n";
+    cout << flush;
+    medir_mutex_hilos("Registro síncrono", false);
+    medir_mutex_hilos("Registro asíncrono", true);
+    cout << "\n";
+    return 0;
+}
+
+// Compara la admision coche a coche con la admision por convoy, en el
+// simulador de eventos (misma semilla, mismo resultado) y con un hilo por coche
+// y colas largas.
+int ejecutar_benchmark_convoy(int coches_por_lado, int tiempo_cruce_ms) {
+    registro_habilitado = false;
+    parametros.coches_defectuosos = false;
+
+    cout << "\nBenchmark de admisión por convoy\n\n";
+    cout << "Simulador de eventos, " << 2 * coches_por_lado * 50 << " coches:\n";
+    bool modos[2] = {false, true};
+    for (bool convoy : modos) {
+        admision_por_convoy = convoy;
+        ResultadoCorredor r = ejecutar_corredor(1, 1, coches_por_lado * 50, 12345);
+        cout << "  " << (convoy ? "Convoy:     " : "Coche a coche:") << " " << fixed << setprecision(3) << r.segundos << " s, "
+             << setprecision(0) << r.generados / max(r.segundos, 1e-9) << " coches/s, " << r.cruzados << " cruzados\n";
+    }
+
+    parametros.coches_por_lado = coches_por_lado;
+    parametros.tiempo_cruce_ms = tiempo_cruce_ms;
+    parametros.retardo_cola_max_ms = 0;
+    parametros.llegada_min_ms = 0;
+    parametros.llegada_rango_ms = 0;
+
+    cout << "\nUn hilo por coche, " << 2 * coches_por_lado << " coches, cruce de " << tiempo_cruce_ms << " ms:\n" << flush;
+    admision_por_convoy = false;
+    medir_mutex_hilos("Coche a coche", false);
+    admision_por_convoy = true;
+    medir_mutex_hilos("Convoy", false);
+    cout << "\n";
+    return 0;
+}
+
+struct ResultadoPolitica {
+    int64_t cruzados = 0;
+    int64_t cambios_turno = 0;
+    int64_t simulado_ms = 0;
+    Histograma espera[2];
+    double segundos = 0;
+};
+
+template <class Politica>
+void configurar_politica(Politica&, const ParametrosSimulacion&) {}
+
+// El reparto ponderado usa como pesos los factores de carga de cada sentido.
+void configurar_politica(PoliticaReparto& politica, const ParametrosSimulacion& params) {
+    politica.fijar_pesos(params.carga.factor[IZQUIERDA], params.carga.factor[DERECHA]);
+}
+
+template <class Politica>
+ResultadoPolitica medir_politica(const ParametrosSimulacion& params, uint64_t semilla) {
+    unique_ptr<MonitorConPolitica<Politica>> puente = make_unique<MonitorConPolitica<Politica>>();
+    configurar_politica(puente->politica, params);
+    SimuladorEventos simulador(*puente, params, semilla);
+
+    ResultadoPolitica r;
+    auto inicio = chrono::steady_clock::now();
+    simulador.ejecutar();
+    r.segundos = chrono::duration<double>(chrono::steady_clock::now() - inicio).count();
+    r.cruzados = puente->total_cruzados;
+    r.cambios_turno = puente->cambios_turno;
+    r.simulado_ms = simulador.tiempo_simulado_ms();
+    for (int d = 0; d < 2; d++) {
+        r.espera[d] = puente->latencia_espera[d].instantanea();
+    }
+    return r;
+}
+
+template <class Politica>
+void mostrar_politica(const ParametrosSimulacion& params, uint64_t semilla) {
+    ResultadoPolitica r = medir_politica<Politica>(params, semilla);
+    Histograma total = r.espera[IZQUIERDA];
+    total.combinar(r.espera[DERECHA]);
+    double horas = max(r.simulado_ms, (int64_t)1) / 3600000.0;
+    cout << left << setw(14) << Politica::nombre << right << fixed << setprecision(0)
+         << setw(10) << r.cruzados / horas << setw(8) << r.cambios_turno << setprecision(1)
+         << setw(9) << total.percentil(50) / 1e6 << setw(9) << total.percentil(99) / 1e6
+         << setw(9) << total.maximo() / 1e6;
+    for (int d = 0; d < 2; d++) cout << setw(10) << r.espera[d].percentil(99) / 1e6;
+    cout << setw(10) << setprecision(3) << r.segundos << "\n";
+}
+
+// Compara las politicas de paso en el simulador de eventos con la misma carga
+// (misma semilla, tipo de llegadas y factores de --carga) y sin coches
+// defectuosos. Las esperas son de tiempo simulado.
+int ejecutar_benchmark_politicas(int coches_por_lado, int tiempo_cruce_ms) {
+    registro_habilitado = false;
+    ParametrosSimulacion params = parametros;
+    params.coches_por_lado = coches_por_lado;
+    params.tiempo_cruce_ms = tiempo_cruce_ms;
+    params.coches_defectuosos = false;
+    uint64_t semilla = parametros.semilla;
+
+    cout << "\nBenchmark de políticas de paso: " << 2 * coches_por_lado << " coches, cruce de " << tiempo_cruce_ms
+         << " ms, llegadas " << (params.llegadas_grabadas ? "fichero" : nombre_llegadas(params.carga.tipo))
+         << ", carga " << params.carga.factor[IZQUIERDA] << ":" << params.carga.factor[DERECHA]
+         << ", semilla " << semilla << "\n\n";
+    cout << left << setw(14) << "Política" << right << setw(10) << "Coches/h" << setw(8) << "Turnos"
+         << setw(9) << "p50" << setw(9) << "p99" << setw(9) << "máx"
+         << setw(10) << "p99 IZQ" << setw(10) << "p99 DER" << setw(10) << "Real (s)" << "\n";
+    mostrar_politica<PoliticaRacha>(params, semilla);
+    mostrar_politica<PoliticaAlternancia>(params, semilla);
+    mostrar_politica<PoliticaProporcional>(params, semilla);
+    mostrar_politica<PoliticaMayorEspera>(params, semilla);
+    mostrar_politica<PoliticaReparto>(params, semilla);
+    cout << "\nEsperas en segundos de tiempo simulado.\n\n";
+    return 0;
+}
+
+// Aplica las entradas de una traza (llegadas, solicitudes, salidas, bloqueos
+// y reanudaciones) a un monitor nuevo, en el orden del fichero y sin esperas.
+// Las admisiones las decide el monitor y se comparan con las grabadas: una
+// traza del simulador de eventos debe reproducirse sin divergencias; en las de
+// hilos el orden del fichero puede no coincidir con el que vio cada CAS.
+class ReproductorTraza {
+private:
+    const EventoTraza* eventos;
+    size_t num_eventos;
+    vector<int32_t> indice;               // coche de cada evento (-1 si no tiene)
+    vector<int32_t> admisiones_grabadas;
+    size_t num_coches = 0;
+
+public:
+    struct Resultado {
+        uint64_t admitidos = 0;
+        uint64_t rechazados = 0;
+        uint64_t divergencias = 0;
+        size_t primera_divergencia = 0;
+    };
+
+    ReproductorTraza(const EventoTraza* ev, size_t n) : eventos(ev), num_eventos(n), indice(n, -1) {
+        // Los id solo son unicos por sentido y mientras el coche esta vivo: cada
+        // llegada abre un coche nuevo para su (sentido, id).
+        unordered_map<uint64_t, int32_t> vivos;
+        for (size_t i = 0; i < n; i++) {
+            if (eventos[i].coche < 0) {
+                continue;
+            }
+            uint64_t clave = ((uint64_t)eventos[i].direccion << 32) | (uint32_t)eventos[i].coche;
+            if (eventos[i].tipo == TRAZA_LLEGADA) {
+                vivos[clave] = (int32_t)num_coches++;
+            }
+            auto it = vivos.find(clave);
+            if (it == vivos.end()) {
+                continue;
+            }
+            indice[i] = it->second;
+            if (eventos[i].tipo == TRAZA_ADMISION) {
+                admisiones_grabadas.push_back(it->second);
+            }
+        }
+    }
+
+    size_t coches() const { return num_coches; }
+
+    Resultado ejecutar() {
+        MonitorPuente puente;
+        vector<Coche> coches(num_coches);
+        vector<uint8_t> salida_pendiente(num_coches, 0);
+        vector<Coche*> resueltos;
+        vector<int32_t> admisiones;
+        admisiones.reserve(admisiones_grabadas.size());
+        Resultado r;
+
+        // El despachador se invoca con mtx tomado: solo se anota el coche y se
+        // atiende despues, fuera del monitor.
+        puente.despachador = [&](Coche* coche) { resueltos.push_back(coche); };
+
+        auto resolver = [&](Coche* coche) {
+            int32_t k = (int32_t)(coche - coches.data());
+            if (coche->estado == RECHAZADO) {
+                r.rechazados++;
+                return;
+            }
+            admisiones.push_back(k);
+            r.admitidos++;
+            if (salida_pendiente[k]) {
+                salida_pendiente[k] = 0;
+                puente.sale_coche(coche);
+            }
+        };
+
+        for (size_t i = 0; i < num_eventos; i++) {
+            const EventoTraza& ev = eventos[i];
+            Coche* coche = (indice[i] >= 0) ? &coches[indice[i]] : nullptr;
+            switch (ev.tipo) {
+                case TRAZA_LLEGADA:
+                    coche->id = ev.coche;
+                    coche->direccion = (Direccion)ev.direccion;
+                    coche->estado = ESPERANDO;
+                    coche->peso_toneladas = ev.peso_toneladas;
+                    coche->altura_metros = ev.altura_metros;
+                    coche->falla_mecanica_grave = ev.falla != 0;
+                    puente.llega_cola(coche);
+                    break;
+                case TRAZA_SOLICITUD:
+                    if (coche && puente.pasa_coche_o_aparcar(coche)) {
+                        resolver(coche);
+                    }
+                    break;
+                case TRAZA_SALIDA:
+                    // En trazas de hilos la salida puede preceder a la admision
+                    // que la reproduccion aun no ha concedido.
+                    if (!coche) break;
+                    if (coche->estado == CRUZANDO) {
+                        puente.sale_coche(coche);
+                    } else {
+                        salida_pendiente[coche - coches.data()] = 1;
+                    }
+                    break;
+                case TRAZA_BLOQUEO:
+                    puente.iniciar_bloqueo_puente("Traza");
+                    puente.sistema_en_pausa = true;
+                    break;
+                case TRAZA_REANUDACION:
+                    puente.reanudar_sistema();
+                    break;
+                default:
+                    continue;
+            }
+            for (size_t j = 0; j < resueltos.size(); j++) {
+                resolver(resueltos[j]);
+            }
+            resueltos.clear();
+        }
+        puente.despachador = nullptr;
+
+        size_t comunes = min(admisiones.size(), admisiones_grabadas.size());
+        r.primera_divergencia = comunes;
+        for (size_t i = 0; i < comunes; i++) {
+            if (admisiones[i] != admisiones_grabadas[i]) {
+                if (r.divergencias == 0) r.primera_divergencia = i;
+                r.divergencias++;
+            }
+        }
+        r.divergencias += max(admisiones.size(), admisiones_grabadas.size()) - comunes;
+        return r;
+    }
+
+    size_t admisiones_en_traza() const { return admisiones_grabadas.size(); }
+};
+
+int ejecutar_reproduccion(const char* ruta, int repeticiones) {
+    registro_habilitado = false;
+
+    LectorTraza<EventoTraza> lector;
+    string error;
+    if (!lector.abrir(ruta, MAGICO_TRAZA, VERSION_TRAZA, error)) {
+        cerr << "Error al leer la traza: " << error << endl;
+        return 1;
+    }
+
+    ReproductorTraza reproductor(lector.registros(), lector.cantidad());
+    ReproductorTraza::Resultado r;
+    auto inicio = chrono::steady_clock::now();
+    for (int i = 0; i < repeticiones; i++) {
+        r = reproductor.ejecutar();
+    }
+    double segundos = chrono::duration<double>(chrono::steady_clock::now() - inicio).count();
+
+    cout << "\n";
+    cout << "Traza:                           " << ruta << "\n";
+    cout << "Eventos en la traza:             " << lector.cantidad() << "\n";
+    cout << "Coches:                          " << reproductor.coches() << "\n";
+    cout << "Admisiones (grabadas/repr.):     " << reproductor.admisiones_en_traza() << " / " << r.admitidos << "\n";
+    cout << "Rechazos reproducidos:           " << r.rechazados << "\n";
+    cout << "Divergencias de admisión:        " << r.divergencias;
+    if (r.divergencias > 0) {
+        cout << " (la primera en la admisión " << r.primera_divergencia + 1 << ")";
+    }
+    cout << "\n";
+    cout << "Repeticiones:                    " << repeticiones << "\n";
+    cout << "Tiempo real:                     " << fixed << setprecision(3) << segundos << " s\n";
+    cout << "Eventos por segundo:             " << setprecision(0) << lector.cantidad() * (double)repeticiones / max(segundos, 1e-9) << "\n";
+    cout << "Coches por segundo:              " << reproductor.coches() * (double)repeticiones / max(segundos, 1e-9) << "\n";
+    cout << "\n";
+    return r.divergencias == 0 ? 0 : 2;
+}
+
+// Campo numerico de una linea CSV, sin salir de [p, fin).
+bool leer_campo_csv(const char*& p, const char* fin, int64_t& valor) {
+    while (p < fin && (*p == ' ' || *p == '\t')) p++;
+    bool negativo = (p < fin && *p == '-');
+    if (negativo) p++;
+    if (p >= fin || !isdigit((unsigned char)*p)) return false;
+    valor = 0;
+    while (p < fin && isdigit((unsigned char)*p)) {
+        valor = valor * 10 + (*p - '0');
+        p++;
+    }
+    if (negativo) valor = -valor;
+    while (p < fin && (*p == ' ' || *p == '\t')) p++;
+    if (p < fin && (*p == ',' || *p == ';')) p++;
+    return true;
+}
+
+// Pasa un CSV "tiempo_ms,direccion,peso,altura,falla" (direccion 0/1 o I/D)
+// al formato binario de --fichero-llegadas. Las lineas que no se entienden
+// (cabecera, comentarios) se saltan.
+int convertir_llegadas_csv(const char* entrada, const char* salida) {
+    int fd = open(entrada, O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1) {
+        perror("Error al abrir el CSV");
+        if (fd != -1) close(fd);
+        return 1;
+    }
+    const char* datos = nullptr;
+    if (st.st_size > 0) {
+        void* mapa = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapa == MAP_FAILED) {
+            perror("Error en mmap");
+            close(fd);
+            return 1;
+        }
+        madvise(mapa, st.st_size, MADV_SEQUENTIAL);
+        datos = static_cast<const char*>(mapa);
+    }
+    close(fd);
+
+    int fd_salida = open(salida, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_salida == -1) {
+        perror("Error al crear el fichero de llegadas");
+        if (datos) munmap(const_cast<char*>(datos), st.st_size);
+        return 1;
+    }
+    struct stat st_salida;
+    bool salida_regular = fstat(fd_salida, &st_salida) == 0 && S_ISREG(st_salida.st_mode);
+    CabeceraTraza cabecera;
+    memcpy(cabecera.magico, MAGICO_LLEGADAS, sizeof(cabecera.magico));
+    cabecera.version = VERSION_LLEGADAS;
+    cabecera.tamano_registro = sizeof(LlegadaGrabada);
+    bool escrito = escribir_todo(fd_salida, &cabecera, sizeof(cabecera));
+
+    const size_t LOTE = 4096;
+    vector<LlegadaGrabada> lote;
+    lote.reserve(LOTE);
+    uint64_t convertidas = 0, saltadas = 0, desordenadas = 0;
+    int64_t anterior = numeric_limits<int64_t>::min();
+
+    const char* p = datos;
+    const char* fin = datos + st.st_size;
+    while (escrito && p < fin) {
+        const char* fin_linea = static_cast<const char*>(memchr(p, '\n', fin - p));
+        if (!fin_linea) fin_linea = fin;
+
+        const char* q = p;
+        int64_t tiempo, dir, peso, altura, falla;
+        bool ok = leer_campo_csv(q, fin_linea, tiempo);
+        if (ok) {
+            while (q < fin_linea && *q == ' ') q++;
+            if (q < fin_linea && (*q == 'I' || *q == 'i' || *q == 'D' || *q == 'd')) {
+                dir = (*q == 'D' || *q == 'd') ? DERECHA : IZQUIERDA;
+                while (q < fin_linea && *q != ',' && *q != ';') q++;
+                if (q < fin_linea) q++;
+            } else {
+                ok = leer_campo_csv(q, fin_linea, dir) && (dir == IZQUIERDA || dir == DERECHA);
+            }
+        }
+        ok = ok && leer_campo_csv(q, fin_linea, peso) && leer_campo_csv(q, fin_linea, altura) && leer_campo_csv(q, fin_linea, falla);
+        ok = ok && peso >= 0 && peso <= 255 && altura >= 0 && altura <= 255;
+
+        if (ok) {
+            LlegadaGrabada r = {};
+            r.tiempo_ms = tiempo;
+            r.direccion = (uint8_t)dir;
+            r.peso_toneladas = (uint8_t)peso;
+            r.altura_metros = (uint8_t)altura;
+            r.falla = falla != 0;
+            if (tiempo < anterior) desordenadas++;
+            anterior = tiempo;
+            lote.push_back(r);
+            convertidas++;
+            if (lote.size() == LOTE) {
+                escrito = escribir_todo(fd_salida, lote.data(), lote.size() * sizeof(LlegadaGrabada));
+                lote.clear();
+            }
+        } else {
+            saltadas++;
+        }
+        p = fin_linea + 1;
+    }
+    escrito = escrito && escribir_todo(fd_salida, lote.data(), lote.size() * sizeof(LlegadaGrabada));
+    // close puede ser el primero en informar de un disco lleno
+    escrito = (close(fd_salida) == 0) && escrito;
+    if (datos) munmap(const_cast<char*>(datos), st.st_size);
+    if (!escrito) {
+        // Una grabacion recortada pasaria por completa al reproducirla
+        perror("Error al escribir el fichero de llegadas");
+        if (salida_regular) unlink(salida);
+        return 1;
+    }
+
+    cout << "Llegadas convertidas: " << convertidas << "  (líneas saltadas: " << saltadas << ")\n";
+    if (desordenadas > 0) {
+        cerr << "Aviso: " << desordenadas << " llegadas fuera de orden; se tratarán como simultáneas a la anterior" << endl;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 2 && strcmp(argv[1], "--reproducir") == 0) {
+        int repeticiones = (argc > 3) ? max(1, atoi(argv[3])) : 1;
+        return ejecutar_reproduccion(argv[2], repeticiones);
+    }
+
+    if (argc > 3 && strcmp(argv[1], "--convertir-llegadas") == 0) {
+        return convertir_llegadas_csv(argv[2], argv[3]);
+    }
+
+    // Opciones previas al modo, cada una con un valor:
+    //   --traza FICHERO     graba las transiciones del monitor global en el modo
+    //                       que siga (hilos, --pool, --corrutinas o --eventos);
+    //                       al salir de main se desengancha del monitor y se
+    //                       vuelca lo pendiente
+    //   --semilla N         repite exactamente los coches de otra ejecucion
+    //   --llegadas TIPO     uniforme, poisson, rafagas o diurna
+    //   --carga IZQ:DER     factores de tasa de llegada de cada sentido
+    //   --fichero-llegadas FICHERO
+    //                       toma los coches de una grabacion (ver
+    //                       --convertir-llegadas) en lugar de sortearlos
+    //   --velocidad F       escala el tiempo de las llegadas en los modos con
+    //                       hilos (0: tan rapido como se pueda)
+    //   --metricas DIR      sirve GET /metrics en formato Prometheus: DIR es un
+    //                       puerto (127.0.0.1), HOST:PUERTO o la ruta de un
+    //                       socket Unix
+    unique_ptr<TrazaPuente> traza;
+    // Se destruye antes que `traza` por cualquier salida de main.
+    struct SoltarTraza { ~SoltarTraza() { monitor.soltar_traza(); } } soltar_traza;
+    ServidorMetricas servidor_metricas;
+    FicheroLlegadas fichero_llegadas;
+    parametros.semilla = random_device{}();
+    while (argc > 2) {
+        if (strcmp(argv[1], "--traza") == 0) {
+            int fd = open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd == -1) {
+                perror("Error al crear la traza");
+                return 1;
+            }
+            traza = make_unique<TrazaPuente>(fd, MAGICO_TRAZA, VERSION_TRAZA);
+            monitor.traza = traza.get();
+        } else if (strcmp(argv[1], "--semilla") == 0) {
+            parametros.semilla = strtoull(argv[2], nullptr, 10);
+        } else if (strcmp(argv[1], "--llegadas") == 0) {
+            if (!leer_tipo_llegadas(argv[2], parametros.carga.tipo)) {
+                cerr << "Tipo de llegadas no válido: " << argv[2] << " (uniforme, poisson, rafagas, diurna)" << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[1], "--fichero-llegadas") == 0) {
+            string error;
+            if (!fichero_llegadas.abrir(argv[2], MAGICO_LLEGADAS, VERSION_LLEGADAS, error)) {
+                cerr << "Error al leer las llegadas: " << error << endl;
+                return 1;
+            }
+            parametros.llegadas_grabadas = &fichero_llegadas;
+        } else if (strcmp(argv[1], "--metricas") == 0) {
+            string error;
+            if (!servidor_metricas.iniciar(argv[2], [] { return metricas_prometheus(monitor); }, error)) {
+                cerr << "Error al abrir el servidor de métricas: " << error << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[1], "--velocidad") == 0) {
+            parametros.velocidad_llegadas = max(0.0, atof(argv[2]));
+        } else if (strcmp(argv[1], "--carga") == 0) {
+            double* factor = parametros.carga.factor;
+            if (sscanf(argv[2], "%lf:%lf", &factor[IZQUIERDA], &factor[DERECHA]) != 2 || factor[IZQUIERDA] <= 0 || factor[DERECHA] <= 0) {
+                cerr << "Carga no válida: " << argv[2] << " (IZQ:DER, por ejemplo 2:0.5)" << endl;
+                return 1;
+            }
+        } else {
+            break;
+        }
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--eventos") == 0) {
+        int coches_por_lado = (argc > 2) ? atoi(argv[2]) : TOTAL_COCHES_POR_LADO;
+        bool verboso = (argc > 3) && strcmp(argv[3], "-v") == 0;
+        return ejecutar_simulacion_eventos(coches_por_lado, verboso);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--bench-pool") == 0) {
+        int coches_por_lado = (argc > 2) ? atoi(argv[2]) : 2000;
+        int num_hilos = (argc > 3) ? atoi(argv[3]) : 4;
+        int tiempo_cruce_ms = (argc > 4) ? atoi(argv[4]) : 1;
+        return ejecutar_benchmark_pool(coches_por_lado, max(1, num_hilos), tiempo_cruce_ms);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--corredor") == 0) {
+        int num_puentes = (argc > 2) ? atoi(argv[2]) : 8;
+        int num_hilos = (argc > 3) ? atoi(argv[3]) : (int)thread::hardware_concurrency();
+        int coches_por_lado = (argc > 4) ? atoi(argv[4]) : 20000;
+        return ejecutar_simulacion_corredor(max(1, num_puentes), max(1, num_hilos), coches_por_lado);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--bench-corredor") == 0) {
+        int coches_por_lado = (argc > 2) ? atoi(argv[2]) : 20000;
+        int max_hilos = (argc > 3) ? atoi(argv[3]) : (int)thread::hardware_concurrency();
+        return ejecutar_benchmark_corredor(coches_por_lado, max(1, max_hilos));
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--barrido") == 0) {
+        return ejecutar_barrido(argc, argv);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--bench-convoy") == 0) {
+        int coches_por_lado = (argc > 2) ? atoi(argv[2]) : 2000;
+        int tiempo_cruce_ms = (argc > 3) ? atoi(argv[3]) : 1;
+        return ejecutar_benchmark_convoy(coches_por_lado, tiempo_cruce_ms);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--bench-politicas") == 0) {
+        int coches_por_lado = (argc > 2) ? atoi(argv[2]) : 2000;
+        int tiempo_cruce_ms = (argc > 3) ? atoi(argv[3]) : TIEMPO_CRUCE_MS;
+        return ejecutar_benchmark_politicas(coches_por_lado, max(1, tiempo_cruce_ms));
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--bench-registro") == 0) {
+        int coches_por_lado = (argc > 2) ? atoi(argv[2]) : 2000;
+        int tiempo_cruce_ms = (argc > 3) ? atoi(argv[3]) : 1;
+        return ejecutar_benchmark_registro(coches_por_lado, tiempo_cruce_ms);
+    }
+
+    ModoEjecucion modo = MODO_HILOS;
+    int num_hilos = 4;
+    if (argc > 1 && (strcmp(argv[1], "--pool") == 0 || strcmp(argv[1], "--corrutinas") == 0)) {
+        modo = (strcmp(argv[1], "--pool") == 0) ? MODO_POOL : MODO_CORRUTINAS;
+        if (argc > 2) num_hilos = max(1, atoi(argv[2]));
+#if !defined(__cpp_impl_coroutine)
+        if (modo == MODO_CORRUTINAS) {
+            cerr << "Este binario se compiló sin soporte de corrutinas (use -std=c++20)" << endl;
+            return 1;
+        }
+#endif
+    }
+
+    RegistroAsincrono<RegistroMonitor> registro(formatear_registro, STDERR_FILENO);
+    // Se destruye antes que `registro` por cualquier salida de main.
+    struct SoltarRegistro { ~SoltarRegistro() { fijar_registro_eventos(nullptr); } } soltar_registro;
+    fijar_registro_eventos(&registro);
+    
+    cout << "\n";
+    cout << "============================================================\n";
+    cout << "         SISTEMA DE CONTROL DEL PUENTE DUERO                \n";
+    cout << "         Grupo no. 2 Sistemas Operativos I III PAC 2025     \n";
+    cout << "============================================================\n";
+    cout << "Semilla: " << parametros.semilla << "  Llegadas: " << (parametros.llegadas_grabadas ? "fichero" : nombre_llegadas(parametros.carga.tipo)) << "\n";
+    cout << "\n";
+    
+    deque<Coche> coches[2];
+    thread generadores[2];
+    unique_ptr<EjecutorCoches> ejecutor;
+    if (modo != MODO_HILOS) {
+        ejecutor = make_unique<EjecutorCoches>(num_hilos);
+    }
+    iniciar_generadores(modo, ejecutor.get(), coches, generadores);
+
+    thread monitor_thread(monitor_estado);
+    thread fallas_thread(detector_fallas);
+    thread intervencion_thread(tarea_intervencion); 
+    
+    intervencion_thread.detach(); 
+    
+    if (generadores[IZQUIERDA].joinable()) generadores[IZQUIERDA].join();
+    if (generadores[DERECHA].joinable()) generadores[DERECHA].join();
+    if (ejecutor) ejecutor->esperar_inactivo();
+    
+    if (monitor.sistema_en_pausa) {
+        cerr << "[" << hora_actual() << "] Generadores terminados, esperando intervención para apagar..." << endl;
+        while (monitor.sistema_en_pausa) {
+            this_thread::sleep_for(chrono::milliseconds(200));
+        }
+        cerr << "[" << hora_actual() << "] Intervención completada. Procediendo al apagado final." << endl;
+    }
+    
+    monitor.sistema_activo = false; 
+
+    monitor.despertar_esperas();
+    monitor.cv_apagado.notify_all(); 
+
+    if (monitor_thread.joinable()) monitor_thread.join();
+    if (fallas_thread.joinable()) fallas_thread.join();
+
+    registro.vaciar();
+    mostrar_estadisticas_finales();
     
-    cerr << "[" << get_timestamp() << "] Sistema finalizado correctamente" << endl;
+    cerr << "[" << hora_actual() << "] Sistema finalizado correctamente" << endl;
     
     return 0;
 }
\ No newline at end of file
@@ -5,109 +5,250 @@
 #include <ctime>
 #include <iomanip>
 #include <cstring> 
-#include <sys/ipc.h>  
-#include <sys/sem.h>  
 #include <wait.h>     
 #include <unistd.h>   
 #include <cstdio>     
 #include <limits>   
 #include <cstdlib>
 #include <algorithm> 
+#include <atomic>
+#include <climits>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "reloj.h"
+#include "monitor_compartido.h"
 
 using namespace std;
 
-#define MAX_COCHES_SIMULTANEOS 3
 #define TOTAL_COCHES_POR_LADO 4 
 #define TIEMPO_CRUCE_MS 1000
+#define NUM_TRABAJADORES 8
+#define CAPACIDAD_TRABAJOS 256
 
-#define SEM_KEY 1234 
-#define NUM_SEMS 1
-#define MUTEX_PUENTE 0 
-
-enum Direccion { IZQUIERDA = 0, DERECHA = 1, NINGUNO = 2 };
 enum EstadoCoche { ESPERANDO, CRUZANDO, FINALIZADO, RECHAZADO }; 
 
-union semun {
-    int val;
-    struct semid_ds *buf;
-    unsigned short *array;
-    struct seminfo *__buf;
+int coches_por_lado = TOTAL_COCHES_POR_LADO;
+bool con_esperas = true;            // llegadas y cruces con su duracion real
+bool usar_trabajadores = true;      // encolar los coches en lugar de un fork por coche
+bool registro_habilitado = true;
+
+void log_evento(const string& mensaje) {
+    if (!registro_habilitado) {
+        return;
+    }
+    fprintf(stderr, "[%s - PID: %d] %s\n", hora_actual(), getpid(), mensaje.c_str());
+}
+
+// Cola de cruces pendientes para los procesos trabajadores, en la misma
+// memoria compartida que el monitor. Los trabajadores duermen en `no_vacia`
+// cuando no hay trabajos y los generadores en `no_llena` cuando no hay hueco;
+// cada trabajo metido despierta a un trabajador y cada hueco a un generador.
+struct Trabajo {
+    int id;
+    Direccion direccion;
 };
 
-int semid; 
+struct ColaTrabajos {
+    atomic<uint32_t> cerrojo;
+    atomic<uint32_t> no_vacia;      // cambia al meter un trabajo o al cerrar
+    atomic<uint32_t> no_llena;      // cambia al sacar un trabajo o al cerrar
+    int esperando_trabajo;          // trabajadores dormidos en no_vacia
+    int esperando_hueco;            // generadores dormidos en no_llena
+    uint64_t metidos;
+    uint64_t sacados;
+    bool cerrada;
+    Trabajo trabajos[CAPACIDAD_TRABAJOS];
 
+    atomic<uint32_t> completados;   // coches que terminaron de cruzar
+    uint32_t objetivo_fin;          // completados que espera esperar_completados
+    int esperando_fin;
 
-string get_timestamp() {
-    time_t now = time(NULL); 
-    tm tm_info;
-    #ifdef _WIN32
-        localtime_s(&tm_info, &now);
-    #else
-        localtime_r(&now, &tm_info);
-    #endif
-    stringstream ss;
-    ss << put_time(&tm_info, "%H:%M:%S");
-    return ss.str();
+    atomic<uint64_t> llamadas_futex;
+};
+
+struct MemoriaCompartida {
+    MonitorCompartido monitor;
+    ColaTrabajos trabajos;
+};
+
+MemoriaCompartida* compartida;
+MonitorCompartido* monitor;
+ColaTrabajos* trabajos;
+
+void crear_memoria_compartida() {
+    void* mem = mmap(NULL, sizeof(MemoriaCompartida), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        perror("Error al crear la memoria compartida");
+        exit(1);
+    }
+    compartida = new (mem) MemoriaCompartida();
+    monitor = &compartida->monitor;
+    trabajos = &compartida->trabajos;
+    inicializar_monitor_compartido(monitor);
 }
 
-void log_evento(const string& mensaje) {
-    fprintf(stderr, "[%s - PID: %d] %s\n", get_timestamp().c_str(), getpid(), mensaje.c_str());
+void destruir_memoria_compartida() {
+    compartida->~MemoriaCompartida();
+    munmap(compartida, sizeof(MemoriaCompartida));
 }
 
-void sem_operacion(int sem_index, int op) {
-    struct sembuf sbuf;
-    sbuf.sem_num = sem_index;
-    sbuf.sem_op = op; 
-    sbuf.sem_flg = 0;
-    if (semop(semid, &sbuf, 1) == -1) {
-        perror("semop error");
-        exit(1); 
-    }
+void pasa_coche(int id, Direccion mi_dir) {
+    PasoCompartido paso = entrar_puente(monitor, mi_dir);
+    log_evento("Coche " + to_string(id) + " COMIENZA CRUCE (en puente: " + to_string(paso.en_puente) +
+               ", seguidos: " + to_string(paso.seguidos) + "/" + to_string(MAX_COCHES_SEGUIDOS) + ")");
 }
 
-void sem_wait() {
-    sem_operacion(MUTEX_PUENTE, -1);
+void sale_coche(Direccion mi_dir) {
+    if (salir_puente(monitor, mi_dir)) {
+        Direccion otra_dir = (mi_dir == IZQUIERDA) ? DERECHA : IZQUIERDA;
+        log_evento(string("Cambio de turno a ") + (otra_dir == IZQUIERDA ? "IZQ" : "DER"));
+    }
 }
 
-void sem_signal() {
-    sem_operacion(MUTEX_PUENTE, 1);
+
+// Cada proceso hijo hereda el estado de rand() del padre: sin resembrar,
+// todos sortearian los mismos tiempos.
+void resembrar() {
+    srand((unsigned)time(NULL) ^ ((unsigned)getpid() << 16));
 }
 
-void tarea_coche(int id, Direccion direccion) {
+void cruzar(int id, Direccion direccion) {
     log_evento("Coche " + to_string(id) + " llega a cola " + (direccion == IZQUIERDA ? "IZQ" : "DER"));
-    log_evento("Coche " + to_string(id) + " ESPERANDO permiso (P).");
+    log_evento("Coche " + to_string(id) + " ESPERANDO permiso.");
     
-    sem_wait(); 
+    pasa_coche(id, direccion);
     
-    log_evento("Coche " + to_string(id) + " COMIENZA CRUCE.");
-    usleep(TIEMPO_CRUCE_MS * 1000 + (rand() % 500) * 1000); 
+    if (con_esperas) {
+        usleep(TIEMPO_CRUCE_MS * 1000 + (rand() % 500) * 1000); 
+    }
 
     log_evento("Coche " + to_string(id) + " FINALIZA CRUCE.");
-    sem_signal(); 
+    sale_coche(direccion); 
+}
 
+void tarea_coche(int id, Direccion direccion) {
+    resembrar();
+    cruzar(id, direccion);
     exit(0); 
 }
 
+// Devuelve false si la cola esta cerrada.
+bool meter_trabajo(const Trabajo& t) {
+    bloquear(trabajos->cerrojo, trabajos->llamadas_futex);
+    while (trabajos->metidos - trabajos->sacados == CAPACIDAD_TRABAJOS && !trabajos->cerrada) {
+        esperar_cambio(trabajos->cerrojo, trabajos->no_llena, trabajos->esperando_hueco, trabajos->llamadas_futex);
+    }
+    bool cerrada = trabajos->cerrada;
+    bool despertar = false;
+    if (!cerrada) {
+        trabajos->trabajos[trabajos->metidos++ % CAPACIDAD_TRABAJOS] = t;
+        despertar = avisar_cambio(trabajos->no_vacia, trabajos->esperando_trabajo);
+    }
+    desbloquear(trabajos->cerrojo, trabajos->llamadas_futex);
+    if (despertar) {
+        futex(&trabajos->no_vacia, FUTEX_WAKE, 1, trabajos->llamadas_futex);
+    }
+    return !cerrada;
+}
+
+// Devuelve false cuando la cola esta cerrada y vacia.
+bool sacar_trabajo(Trabajo& t) {
+    bloquear(trabajos->cerrojo, trabajos->llamadas_futex);
+    while (trabajos->metidos == trabajos->sacados && !trabajos->cerrada) {
+        esperar_cambio(trabajos->cerrojo, trabajos->no_vacia, trabajos->esperando_trabajo, trabajos->llamadas_futex);
+    }
+    bool hay = trabajos->metidos != trabajos->sacados;
+    bool despertar = false;
+    if (hay) {
+        t = trabajos->trabajos[trabajos->sacados++ % CAPACIDAD_TRABAJOS];
+        despertar = avisar_cambio(trabajos->no_llena, trabajos->esperando_hueco);
+    }
+    desbloquear(trabajos->cerrojo, trabajos->llamadas_futex);
+    if (despertar) {
+        futex(&trabajos->no_llena, FUTEX_WAKE, 1, trabajos->llamadas_futex);
+    }
+    return hay;
+}
+
+// Al cerrar si se despierta a todos: ninguno volvera a dormir.
+void cerrar_cola() {
+    bloquear(trabajos->cerrojo, trabajos->llamadas_futex);
+    trabajos->cerrada = true;
+    bool despertar_trabajadores = avisar_cambio(trabajos->no_vacia, trabajos->esperando_trabajo);
+    bool despertar_generadores = avisar_cambio(trabajos->no_llena, trabajos->esperando_hueco);
+    desbloquear(trabajos->cerrojo, trabajos->llamadas_futex);
+    if (despertar_trabajadores) {
+        futex(&trabajos->no_vacia, FUTEX_WAKE, INT_MAX, trabajos->llamadas_futex);
+    }
+    if (despertar_generadores) {
+        futex(&trabajos->no_llena, FUTEX_WAKE, INT_MAX, trabajos->llamadas_futex);
+    }
+}
+
+void completar_trabajo() {
+    bloquear(trabajos->cerrojo, trabajos->llamadas_futex);
+    // El propio contador es la palabra futex; solo se despierta al llegar al
+    // objetivo, no en cada coche.
+    uint32_t hechos = trabajos->completados.fetch_add(1) + 1;
+    bool despertar = trabajos->esperando_fin > 0 && hechos >= trabajos->objetivo_fin;
+    desbloquear(trabajos->cerrojo, trabajos->llamadas_futex);
+    if (despertar) {
+        futex(&trabajos->completados, FUTEX_WAKE, INT_MAX, trabajos->llamadas_futex);
+    }
+}
+
+void esperar_completados(uint32_t total) {
+    bloquear(trabajos->cerrojo, trabajos->llamadas_futex);
+    trabajos->objetivo_fin = total;
+    while (trabajos->completados.load() < total) {
+        esperar_cambio(trabajos->cerrojo, trabajos->completados, trabajos->esperando_fin, trabajos->llamadas_futex);
+    }
+    desbloquear(trabajos->cerrojo, trabajos->llamadas_futex);
+}
+
+// Proceso creado una sola vez que cruza un coche tras otro.
+void trabajador() {
+    resembrar();
+    Trabajo t;
+    while (sacar_trabajo(t)) {
+        cruzar(t.id, t.direccion);
+        completar_trabajo();
+    }
+    exit(0);
+}
+
 void generador_coches(Direccion direccion) {
+    resembrar();
     
     char log_message[100];
     const char* dir_str = (direccion == IZQUIERDA ? "IZQ" : "DER");
     
-    sprintf(log_message, "[%s - PID: %d] Generador %s iniciado.", get_timestamp().c_str(), getpid(), dir_str);
-    fprintf(stderr, "%s\n", log_message);
+    if (registro_habilitado) {
+        sprintf(log_message, "[%s - PID: %d] Generador %s iniciado.", hora_actual(), getpid(), dir_str);
+        fprintf(stderr, "%s\n", log_message);
+    }
     
-    for (int i = 0; i < TOTAL_COCHES_POR_LADO; i++) {
+    for (int i = 0; i < coches_por_lado; i++) {
         int id = (direccion * 100) + i + 1;
         
-        pid_t pid = fork();
-
-        if (pid < 0) {
-            perror("Error al hacer fork");
-            exit(1);
-        } else if (pid == 0) {
-            tarea_coche(id, direccion);
+        if (usar_trabajadores) {
+            meter_trabajo(Trabajo{id, direccion});
+            log_evento("Proceso Generador encoló Coche " + to_string(id));
         } else {
-            log_evento("Proceso Generador creó Coche " + to_string(id) + " (PID Hijo: " + to_string(pid) + ")");
+            pid_t pid = fork();
+
+            if (pid < 0) {
+                perror("Error al hacer fork");
+                exit(1);
+            } else if (pid == 0) {
+                tarea_coche(id, direccion);
+            } else {
+                log_evento("Proceso Generador creó Coche " + to_string(id) + " (PID Hijo: " + to_string(pid) + ")");
+            }
+        }
+        if (con_esperas) {
             usleep(500000 + rand() % 1500000); 
         }
     }
@@ -117,60 +258,119 @@ void generador_coches(Direccion direccion) {
     
     while ((wpid = wait(&status)) > 0);
     
-    sprintf(log_message, "[%s - PID: %d] Generador %s finalizado.", get_timestamp().c_str(), getpid(), dir_str);
-    fprintf(stderr, "%s\n", log_message);
+    if (registro_habilitado) {
+        sprintf(log_message, "[%s - PID: %d] Generador %s finalizado.", hora_actual(), getpid(), dir_str);
+        fprintf(stderr, "%s\n", log_message);
+    }
 
     exit(0); 
 }
 
-int main() {
-    srand(time(NULL)); 
-    
-    semid = semget(SEM_KEY, NUM_SEMS, IPC_CREAT | 0666);
-    if (semid == -1) {
-        perror("Error al crear semáforo");
-        return 1;
-    }
-    
-    union semun arg;
-    arg.val = MAX_COCHES_SIMULTANEOS;
-    if (semctl(semid, MUTEX_PUENTE, SETVAL, arg) == -1) {
-        perror("Error al inicializar semáforo");
-        return 1;
+pid_t crear_proceso(void (*funcion)()) {
+    cout.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("Error al hacer fork");
+        exit(1);
+    } else if (pid == 0) {
+        funcion();
     }
-    log_evento("Semáforo IPC (ID: " + to_string(semid) + ") creado e inicializado con valor " + to_string(MAX_COCHES_SIMULTANEOS));
+    return pid;
+}
 
-    pid_t pid_izq, pid_der;
-    
-    if ((pid_izq = fork()) == 0) {
-        generador_coches(IZQUIERDA);
-    } else if (pid_izq < 0) {
-        perror("Error fork izq");
-        return 1;
+// Ejecuta una simulacion completa con `num_trabajadores` procesos creados de
+// antemano, o con un proceso por coche si es 0.
+void simular(int num_trabajadores) {
+    bool pool = num_trabajadores > 0;
+    usar_trabajadores = pool;
+    for (int i = 0; i < num_trabajadores; i++) {
+        crear_proceso(trabajador);
     }
+    if (pool) {
+        log_evento(to_string(num_trabajadores) + " procesos trabajadores creados");
+    }
+
+    crear_proceso([] { generador_coches(IZQUIERDA); });
+    crear_proceso([] { generador_coches(DERECHA); });
 
-    if ((pid_der = fork()) == 0) {
-        generador_coches(DERECHA);
-    } else if (pid_der < 0) {
-        perror("Error fork der");
-        return 1;
+    if (pool) {
+        esperar_completados(2 * coches_por_lado);
+        cerrar_cola();
     }
 
     int status;
     pid_t wpid;
     
-    log_evento("Proceso Principal esperando a que los generadores terminen...");
+    log_evento("Proceso Principal esperando a que los procesos hijos terminen...");
     while ((wpid = wait(&status)) > 0) {
         log_evento("Proceso hijo terminado (PID: " + to_string(wpid) + ")");
     }
-    
-    if (semctl(semid, 0, IPC_RMID) == -1) {
-        perror("Error al eliminar semáforo");
-        return 1;
+}
+
+// Los mismos coches con un proceso por coche y con trabajadores creados de
+// antemano, sin esperas de llegada ni de cruce: el tiempo es el de crear,
+// planificar y recoger procesos mas el del monitor.
+int ejecutar_benchmark(int num_trabajadores) {
+    registro_habilitado = false;
+    con_esperas = false;
+    int coches = 2 * coches_por_lado;
+
+    cout << "\nBenchmark de procesos: " << coches << " coches\n\n";
+    cout << left << setw(24) << "Modelo" << right << setw(12) << "Tiempo (s)" << setw(12) << "Coches/s"
+         << setw(14) << "us por coche" << setw(10) << "Procesos" << setw(14) << "Futex/coche" << "\n";
+
+    for (int trabajadores : {0, num_trabajadores}) {
+        crear_memoria_compartida();
+        int64_t inicio = reloj_monotonico_ns();
+        simular(trabajadores);
+        double segundos = (reloj_monotonico_ns() - inicio) / 1e9;
+
+        string nombre = trabajadores ? "trabajadores (" + to_string(trabajadores) + ")" : "fork por coche";
+        int procesos = 2 + (trabajadores ? trabajadores : coches);
+        cout << left << setw(24) << nombre << right << fixed << setprecision(3) << setw(12) << segundos
+             << setprecision(0) << setw(12) << coches / segundos
+             << setprecision(1) << setw(14) << segundos * 1e6 / coches << setw(10) << procesos
+             << setprecision(2) << setw(14) << (double)(monitor->llamadas_futex + trabajos->llamadas_futex) / coches << "\n";
+        destruir_memoria_compartida();
+    }
+    cout << "\n";
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    srand(time(NULL)); 
+
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        coches_por_lado = (argc > 2) ? max(1, atoi(argv[2])) : 2000;
+        int num_trabajadores = (argc > 3) ? max(1, atoi(argv[3])) : NUM_TRABAJADORES;
+        return ejecutar_benchmark(num_trabajadores);
+    }
+
+    int num_trabajadores = NUM_TRABAJADORES;
+    if (argc > 1 && strcmp(argv[1], "--fork-por-coche") == 0) {
+        num_trabajadores = 0;
+    } else if (argc > 2 && strcmp(argv[1], "--trabajadores") == 0) {
+        num_trabajadores = max(1, atoi(argv[2]));
     }
-    log_evento("Sistema IPC (semáforo) eliminado.");
     
+    crear_memoria_compartida();
+    log_evento("Monitor compartido creado (máx. " + to_string(MAX_COCHES_SIMULTANEOS) + " coches, " +
+               to_string(MAX_COCHES_SEGUIDOS) + " seguidos)");
+
+    simular(num_trabajadores);
+    
+    int coches = 2 * coches_por_lado;
+    uint64_t llamadas = monitor->llamadas_futex.load();
     cout << "\n--- SIMULACIÓN FINALIZADA ---\n";
+    cout << "Máximo de coches a la vez en el puente: " << monitor->max_en_puente << "\n";
+    cout << "Cambios de turno: " << monitor->cambios_turno << "\n";
+    cout << "Llamadas futex del monitor: " << llamadas << " (" << fixed << setprecision(2) << (double)llamadas / coches
+         << " por coche; el semáforo System V hacía 2 semop por coche)\n";
+    if (num_trabajadores > 0) {
+        cout << "Llamadas futex de la cola de trabajos: " << trabajos->llamadas_futex << "\n";
+    }
+
+    destruir_memoria_compartida();
     
     return 0;
-}
\ No newline at end of file
+}